@@ -0,0 +1,239 @@
+#include "BatchSearch.h"
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+// pairs waiting on a target of a group
+struct TargetPairs {
+    vector<size_t> pairs;
+    bool           reached = false;
+};
+
+// the bfs shared by every pair with the same start
+struct BatchSearch::Group {
+    WorkId                           start;
+    FlatMap<WorkId, TargetPairs>     targets;
+    size_t                           remaining = 0; // targets not reached yet
+    int                              floor = 0;     // year of the oldest of those; older works cannot lead to one
+    FlatMap<WorkId, WorkId>          prev;
+    vector<WorkId>                   level;
+    size_t                           depth = 0;
+    size_t                           budget = 0;    // works left to expand
+    bool                             failed = false; // a batch of its works could not be fetched
+};
+
+BatchSearch::BatchSearch(ClientPool& pool, const size_t in_flight)
+    : pool_(pool), in_flight_(max(in_flight, size_t(1))) {}
+
+// fetches the references and years of the works in ids that are not held yet; returns the works whose batch
+// failed, which are not held, so a later fetch asks for them again
+unordered_set<WorkId> BatchSearch::fetch(const vector<WorkId>& ids) {
+    unordered_set<WorkId> not_fetched;
+    for (const WorkId id : ids) {
+        if (id && !held_.contains(id)) not_fetched.insert(id);
+    }
+    if (not_fetched.empty()) return not_fetched;
+    const vector<WorkId> asked(not_fetched.begin(), not_fetched.end());
+    // every work's references are kept, as searches towards targets of different years share them
+    get_refs(pool_, not_fetched, refs_, numeric_limits<int>::min(), &years_);
+    for (const WorkId id : asked) {
+        if (not_fetched.contains(id) || !held_.insert(id).second) continue;
+        loaded_.push_back(id);
+        fetched_++;
+    }
+    return not_fetched;
+}
+
+// drops what was fetched for a wave, now that it is done, but for the starts and targets of later waves;
+// done holds those of the wave
+void BatchSearch::evict(const vector<WorkId>& done) {
+    auto drop = [&](const WorkId id) {
+        refs_.erase(id);
+        years_.erase(id);
+        held_.erase(id);
+    };
+    for (const WorkId id : done) {
+        auto it = endpoints_.find(id);
+        if (--it->second) continue;
+        endpoints_.erase(it);
+        drop(id);
+    }
+    for (const WorkId id : loaded_) {
+        if (!endpoints_.contains(id)) drop(id);
+    }
+    loaded_.clear();
+}
+
+// the work IDs of every pair's start and target, or the null ID for works that were not found; returns the
+// works that could not be fetched
+// W-numbers are looked up together, with the references of the starts that they fetch anyway; other IDs
+// (DOIs) can only be resolved one request at a time
+unordered_set<WorkId> BatchSearch::resolve(const vector<PairQuery>& pairs, vector<WorkId>& start_ids, vector<WorkId>& target_ids) {
+    unordered_map<string, WorkId> resolved;
+    vector<WorkId> regular;
+    for (const auto& pair : pairs) {
+        for (const string* id : {&pair.start, &pair.target}) {
+            auto [it, added] = resolved.try_emplace(*id, WorkId::parse(*id));
+            if (!added) continue;
+            if (it->second) {
+                regular.push_back(it->second);
+                continue;
+            }
+            json work = get_work(pool_[0], *id);
+            if (work.is_null()) continue;
+            it->second = WorkId::from_string(work.value("id", *id));
+            years_[it->second] = work.value("publication_year", 0);
+            loaded_.push_back(it->second);
+        }
+    }
+    unordered_set<WorkId> failed = fetch(regular);
+
+    for (const auto& pair : pairs) {
+        start_ids.push_back(resolved[pair.start]);
+        target_ids.push_back(resolved[pair.target]);
+    }
+    return failed;
+}
+
+void BatchSearch::run(const vector<PairQuery>& pairs, const function<void(const PairResult&)>& emit) {
+    vector<WorkId> start_ids, target_ids;
+    const unordered_set<WorkId> failed = resolve(pairs, start_ids, target_ids);
+
+    // pairs that need no search are answered straight away; the rest are grouped by start
+    vector<Group> groups;
+    unordered_map<WorkId, size_t> group_of;
+    for (size_t i = 0; i < pairs.size(); i++) {
+        PairResult result{i, pairs[i].start, pairs[i].target};
+        const auto start_year = years_.find(start_ids[i]);
+        const auto target_year = years_.find(target_ids[i]);
+        if (failed.contains(start_ids[i]) || failed.contains(target_ids[i])) {
+            result.error = "Could not fetch work";
+        } else if (start_year == years_.end() || target_year == years_.end()) {
+            result.error = "Work not found";
+        } else if (start_year->second < target_year->second) { // references only go from newer → older
+            result.error = "Start paper must be newer than end paper";
+        } else if (start_ids[i] == target_ids[i]) {
+            result.path.push_back(start_ids[i]);
+        } else {
+            auto [it, added] = group_of.try_emplace(start_ids[i], groups.size());
+            if (added) {
+                groups.emplace_back();
+                groups.back().start = start_ids[i];
+            }
+            if (added) endpoints_[start_ids[i]]++;
+            TargetPairs& target = groups[it->second].targets[target_ids[i]];
+            if (target.pairs.empty()) {
+                groups[it->second].remaining++;
+                endpoints_[target_ids[i]]++;
+            }
+            target.pairs.push_back(i);
+            continue;
+        }
+        emit(result);
+    }
+
+    // works fetched for the pairs answered already are not needed any more
+    evict({});
+    for (size_t first = 0; first < groups.size(); first += in_flight_) {
+        vector<Group> wave(make_move_iterator(groups.begin() + first),
+                           make_move_iterator(groups.begin() + min(first + in_flight_, groups.size())));
+        vector<WorkId> done;
+        for (const Group& g : wave) {
+            done.push_back(g.start);
+            for (const auto& [target, waiting] : g.targets) done.push_back(target);
+        }
+        run_wave(pairs, wave, emit);
+        evict(done);
+    }
+}
+
+// the oldest year of the targets a group has not reached yet
+static int target_floor(const FlatMap<WorkId, TargetPairs>& targets, const YearMap& years) {
+    int floor = numeric_limits<int>::max();
+    for (const auto& [target, pairs] : targets) {
+        if (!pairs.reached) floor = min(floor, years.at(target));
+    }
+    return floor;
+}
+
+void BatchSearch::run_wave(const vector<PairQuery>& pairs, vector<Group>& groups,
+                           const function<void(const PairResult&)>& emit) {
+    // the path to target, from the bfs tree of its group, to every pair waiting on it
+    auto reach = [&](Group& g, const WorkId target, TargetPairs& waiting) {
+        vector<WorkId> path{target};
+        for (WorkId v = target; v != g.start; ) {
+            v = g.prev.at(v);
+            path.push_back(v);
+        }
+        reverse(path.begin(), path.end());
+        for (const size_t i : waiting.pairs) emit({i, pairs[i].start, pairs[i].target, path});
+        waiting.reached = true;
+        if (--g.remaining) g.floor = target_floor(g.targets, years_);
+    };
+
+    vector<Group*> active;
+    for (Group& g : groups) {
+        g.prev[g.start] = g.start;
+        g.level.push_back(g.start);
+        g.budget = max_size * g.remaining;
+        g.floor = target_floor(g.targets, years_);
+        active.push_back(&g);
+    }
+
+    vector<WorkId> frontier;
+    while (!active.empty()) {
+        // the next level of every search goes out in the same batches, so a work on several is fetched once
+        frontier.clear();
+        for (const Group* g : active) {
+            frontier.insert(frontier.end(), g->level.begin(), g->level.begin() + min(g->level.size(), g->budget));
+        }
+        const unordered_set<WorkId> failed = fetch(frontier);
+
+        for (Group* g : active) {
+            vector<WorkId> next_level;
+            const size_t expand = min(g->level.size(), g->budget);
+            // without all of a level's references the search could miss the shortest path, so it stops
+            g->failed = any_of(g->level.begin(), g->level.begin() + expand,
+                               [&](const WorkId u) { return failed.contains(u); });
+            if (g->failed) continue;
+            for (size_t i = 0; i < expand && g->remaining; i++) {
+                const WorkId u = g->level[i];
+                // as get_refs with the targets' year: works older than all of them are not followed
+                const auto year = years_.find(u);
+                const auto refs = refs_.find(u);
+                if (year == years_.end() || year->second < g->floor || refs == refs_.end()) continue;
+
+                // traverse references only
+                for (const WorkId v : refs->second) {
+                    if (!g->prev.try_emplace(v, u).second) continue;
+                    next_level.push_back(v);
+                    auto target = g->targets.find(v);
+                    if (target != g->targets.end()) {
+                        reach(*g, v, target->second);
+                        if (!g->remaining) break;
+                    }
+                }
+            }
+            g->budget -= expand;
+            g->depth++;
+            g->level.swap(next_level);
+        }
+
+        // searches that are done report the targets they did not reach
+        erase_if(active, [&](Group* g) {
+            if (!g->failed && g->remaining && !g->level.empty() && g->depth < max_depth && g->budget) return false;
+            for (const auto& [target, waiting] : g->targets) {
+                if (waiting.reached) continue;
+                for (const size_t i : waiting.pairs) {
+                    PairResult result{i, pairs[i].start, pairs[i].target};
+                    if (g->failed) result.error = "Could not fetch references";
+                    emit(result);
+                }
+            }
+            // the rest of its tree is not needed any more
+            *g = Group();
+            return true;
+        });
+    }
+}
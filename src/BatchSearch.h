@@ -0,0 +1,67 @@
+#ifndef BATCHSEARCH_H
+#define BATCHSEARCH_H
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "FlatMap.h"
+#include "openalex.h"
+
+using namespace std;
+
+// one start/target pair of a batch; the IDs may be DOIs
+struct PairQuery {
+    string start;
+    string target;
+};
+
+// the shortest path found for a pair, over references only, as graph_by_bfs finds it
+struct PairResult {
+    size_t         index = 0; // of the pair in the batch
+    string         start;     // as given
+    string         target;
+    vector<WorkId> path;      // start → target; empty if there is none within the search's limits
+    string         error;     // set if the pair could not be searched, or its search could not fetch references
+};
+
+// shortest paths for many pairs at once, fetching each work's references once for the whole batch
+// pairs with the same start share one bfs that runs until it has reached all of their targets, and the
+// bfs of up to in_flight starts advance level by level together, so the works on all of their frontiers go
+// out in the same batched requests; the number of requests follows the number of distinct works the
+// searches touch rather than the number of pairs
+// what a wave fetched is dropped once it is done, but for the starts and targets of the waves still to run
+class BatchSearch {
+public:
+    explicit BatchSearch(ClientPool& pool, size_t in_flight = 256);
+
+    // searches every pair, passing each result to emit as soon as it is known, so not in the order of pairs
+    void run(const vector<PairQuery>& pairs, const function<void(const PairResult&)>& emit);
+
+    // works whose references have been fetched (or read from the cache) so far; one that a later wave needs
+    // again after it was dropped counts again
+    size_t fetched() const { return fetched_; }
+private:
+    struct Group;
+    unordered_set<WorkId> resolve(const vector<PairQuery>& pairs, vector<WorkId>& start_ids, vector<WorkId>& target_ids);
+    unordered_set<WorkId> fetch(const vector<WorkId>& ids);
+    void evict(const vector<WorkId>& done);
+    void run_wave(const vector<PairQuery>& pairs, vector<Group>& groups,
+                  const function<void(const PairResult&)>& emit);
+
+    // the search limits of graph_by_bfs: levels, and works expanded per target
+    static constexpr size_t max_depth = 10;
+    static constexpr size_t max_size = 500;
+
+    ClientPool&                   pool_;
+    size_t                        in_flight_;
+    RefMap                        refs_;      // of every work held, whatever its year; each search skips those older than its targets
+    YearMap                       years_;
+    unordered_set<WorkId>         held_;      // works whose references and year are in refs_ and years_
+    vector<WorkId>                loaded_;    // works held since the last eviction, but for pending endpoints
+    unordered_map<WorkId, size_t> endpoints_; // groups not run yet that start at or target each work
+    size_t                        fetched_ = 0;
+};
+
+#endif //BATCHSEARCH_H
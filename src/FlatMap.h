@@ -0,0 +1,238 @@
+#ifndef FLATMAP_H
+#define FLATMAP_H
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FLATMAP_SSE2
+#endif
+
+using namespace std;
+
+// open addressing hash map in the style of a Swiss table, for the searches' maps keyed by work ID or node
+// the entries sit in one flat array next to an array of control bytes, one per slot: empty, or 7 bits of the
+// key's hash; a lookup compares 16 control bytes at once (one SSE2 compare where available) and only looks at
+// the entries whose bits match, so it rarely touches more than one cache line of entries
+// - keys and values must be default constructible; every slot holds a pair, empty ones default constructed
+// - entries never move until the table grows; reserve() ahead of a search keeps it from growing part way through
+// - there is no erase, which the searches do not need, so probe sequences never pass over tombstones
+template <typename Key, typename Value, typename Hash = hash<Key>>
+class FlatMap {
+public:
+    using value_type = pair<Key, Value>;
+
+    template <bool Const>
+    class Iterator {
+    public:
+        using ref = conditional_t<Const, const value_type&, value_type&>;
+        using ptr = conditional_t<Const, const value_type*, value_type*>;
+        Iterator(const FlatMap* map, size_t i) : map_(map), i_(i) { skip(); }
+        ref operator*()  const { return const_cast<ref>(map_->slots_[i_]); }
+        ptr operator->() const { return &**this; }
+        Iterator& operator++() { ++i_; skip(); return *this; }
+        bool operator==(const Iterator& other) const { return i_ == other.i_; }
+        operator Iterator<true>() const requires (!Const) { return {map_, i_}; }
+    private:
+        void skip() { while (i_ < map_->capacity_ && map_->ctrl_[i_] < 0) ++i_; }
+        const FlatMap* map_;
+        size_t         i_;
+    };
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    FlatMap() = default;
+    explicit FlatMap(size_t expected) { reserve(expected); }
+
+    size_t size()     const { return size_; }
+    bool   empty()    const { return size_ == 0; }
+    size_t capacity() const { return capacity_; }
+
+    iterator       begin()       { return {this, 0}; }
+    iterator       end()         { return {this, capacity_}; }
+    const_iterator begin() const { return {this, 0}; }
+    const_iterator end()   const { return {this, capacity_}; }
+
+    // makes room for expected entries in total, so that many can be added without growing
+    void reserve(size_t expected) {
+        size_t capacity = group_size;
+        while (capacity - capacity / 8 < expected) capacity *= 2;
+        if (capacity > capacity_) rehash(capacity);
+    }
+
+    // removes every entry, keeping the capacity
+    void clear() {
+        if (!capacity_) return;
+        memset(ctrl_.data(), empty_ctrl, ctrl_.size());
+        for (auto& slot : slots_) slot = value_type();
+        size_ = 0;
+    }
+    // as clear(), given the key of every entry, in time of their number rather than of the capacity; for a map
+    // reserved for large searches and cleared after each of many small ones
+    // the slots are all found before any is emptied, as emptying one can end the probe sequence of another
+    void clear(const vector<Key>& keys) {
+        if (keys.size() >= capacity_ / group_size) return clear();
+        vector<size_t> used;
+        used.reserve(keys.size());
+        for (const Key& key : keys) {
+            const size_t i = find_index(key);
+            if (i != capacity_) used.push_back(i);
+        }
+        for (const size_t i : used) {
+            if (ctrl_[i] < 0) continue; // a key given twice
+            set_ctrl(i, empty_ctrl);
+            slots_[i] = value_type();
+            --size_;
+        }
+        if (size_) clear(); // keys missed some
+    }
+
+    iterator find(const Key& key) {
+        return {this, find_index(key)};
+    }
+    const_iterator find(const Key& key) const {
+        return {this, find_index(key)};
+    }
+    bool   contains(const Key& key) const { return find_index(key) != capacity_; }
+    size_t count(const Key& key)    const { return contains(key); }
+
+    Value& at(const Key& key) {
+        const size_t i = find_index(key);
+        if (i == capacity_) throw out_of_range("FlatMap::at");
+        return slots_[i].second;
+    }
+    const Value& at(const Key& key) const {
+        return const_cast<FlatMap*>(this)->at(key);
+    }
+
+    // the entry of key, adding it with value if there is none; the bool is true if it was added
+    pair<iterator, bool> try_emplace(const Key& key, Value value = Value()) {
+        if (capacity_) {
+            const size_t i = find_index(key);
+            if (i != capacity_) return {{this, i}, false};
+        }
+        if (size_ + 1 > capacity_ - capacity_ / 8) rehash(capacity_ ? capacity_ * 2 : group_size);
+        const size_t i = insert_new(key);
+        slots_[i].second = move(value);
+        return {{this, i}, true};
+    }
+    Value& operator[](const Key& key) {
+        return try_emplace(key).first->second;
+    }
+private:
+    static constexpr size_t group_size = 16;
+    static constexpr int8_t empty_ctrl = -128;
+
+    // bit i set where byte i of the group at ctrl equals c
+    static uint32_t match(const int8_t* ctrl, const int8_t c) {
+#ifdef FLATMAP_SSE2
+        const __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(c))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < group_size; ++i) mask |= uint32_t(ctrl[i] == c) << i;
+        return mask;
+#endif
+    }
+
+    // the home position of a key, from the top bits of its mixed hash, and the 7 bits kept in its control byte
+    uint64_t mixed_hash(const Key& key) const {
+        return static_cast<uint64_t>(Hash{}(key)) * 0x9E3779B97F4A7C15ull;
+    }
+    static int8_t h2(const uint64_t h) { return static_cast<int8_t>((h >> 32) & 0x7F); }
+
+    // slot of key, or capacity_ if it is not in the map
+    // groups are probed at triangular offsets, which visits every group of a power of two table
+    size_t find_index(const Key& key) const {
+        if (!size_) return capacity_;
+        const uint64_t h = mixed_hash(key);
+        const int8_t tag = h2(h);
+        const size_t mask = capacity_ - 1;
+        size_t pos = static_cast<size_t>(h >> shift_);
+        for (size_t step = group_size; ; step += group_size) {
+            const int8_t* group = ctrl_.data() + pos;
+            for (uint32_t m = match(group, tag); m; m &= m - 1) {
+                const size_t i = (pos + countr_zero(m)) & mask;
+                if (slots_[i].first == key) return i;
+            }
+            if (match(group, empty_ctrl)) return capacity_;
+            pos = (pos + step) & mask;
+        }
+    }
+
+    // claims the first empty slot on key's probe sequence; key must not be in the map and there must be room
+    size_t insert_new(const Key& key) {
+        const uint64_t h = mixed_hash(key);
+        const size_t mask = capacity_ - 1;
+        size_t pos = static_cast<size_t>(h >> shift_);
+        for (size_t step = group_size; ; step += group_size) {
+            const uint32_t empty = match(ctrl_.data() + pos, empty_ctrl);
+            if (empty) {
+                const size_t i = (pos + countr_zero(empty)) & mask;
+                set_ctrl(i, h2(h));
+                slots_[i].first = key;
+                ++size_;
+                return i;
+            }
+            pos = (pos + step) & mask;
+        }
+    }
+
+    // the first group_size control bytes are mirrored past the end, so a group starting near the end can be
+    // loaded in one piece
+    void set_ctrl(const size_t i, const int8_t c) {
+        ctrl_[i] = c;
+        if (i < group_size) ctrl_[capacity_ + i] = c;
+    }
+
+    void rehash(const size_t capacity) {
+        vector<int8_t> old_ctrl = move(ctrl_);
+        vector<value_type> old_slots = move(slots_);
+        const size_t old_capacity = capacity_;
+
+        capacity_ = capacity;
+        shift_ = 64 - countr_zero(capacity);
+        ctrl_.assign(capacity + group_size, empty_ctrl);
+        slots_.assign(capacity, value_type());
+        size_ = 0;
+        for (size_t i = 0; i < old_capacity; ++i) {
+            if (old_ctrl[i] < 0) continue;
+            const size_t j = insert_new(old_slots[i].first);
+            slots_[j].second = move(old_slots[i].second);
+        }
+    }
+
+    vector<int8_t>     ctrl_;
+    vector<value_type> slots_;
+    size_t             capacity_ = 0;
+    size_t             size_ = 0;
+    unsigned           shift_ = 64;
+};
+
+// set counterpart of FlatMap
+template <typename Key, typename Hash = hash<Key>>
+class FlatSet {
+public:
+    FlatSet() = default;
+    explicit FlatSet(size_t expected) : map_(expected) {}
+
+    size_t size()  const { return map_.size(); }
+    bool   empty() const { return map_.empty(); }
+    void   reserve(size_t expected) { map_.reserve(expected); }
+    void   clear() { map_.clear(); }
+    bool   contains(const Key& key) const { return map_.contains(key); }
+    size_t count(const Key& key)    const { return map_.count(key); }
+    // true if key was added, false if it was already there
+    bool   insert(const Key& key) { return map_.try_emplace(key).second; }
+private:
+    struct Empty {};
+    FlatMap<Key, Empty, Hash> map_;
+};
+
+#endif //FLATMAP_H
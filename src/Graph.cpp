@@ -2,8 +2,12 @@
 #include <iostream>
 #include "openalex.h"
 #include <chrono>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <set>
 
-size_t Graph::add_node(const string& id, const string& title) {
+size_t Graph::add_node(const WorkId id, const string& title) {
     auto it = idx_.find(id);
     if (it == idx_.end()) {
         nodes_.emplace_back(id, title);
@@ -14,30 +18,53 @@ size_t Graph::add_node(const string& id, const string& title) {
     return it->second;
 }
 
-// record directed edge and link nodes for traversal
-void Graph::add_edge(const string& from_id, const string& to_id) {
+// record directed edge; it is traversable after the next finalize()
+void Graph::add_edge(const WorkId from_id, const WorkId to_id) {
     size_t a = add_node(from_id, "<title>");
     size_t b = add_node(to_id,   "<title>");
-    dir_.push_back({a, b});
-    nodes_[a].nbr_.push_back(ref(nodes_[b])); // undirected link a->b
-    nodes_[b].nbr_.push_back(ref(nodes_[a])); // undirected link b->a
+    dir_.push_back({static_cast<uint32_t>(a), static_cast<uint32_t>(b)});
+}
+
+// lays out the edges added so far as CSR, counting each node's edges and then placing them
+void Graph::finalize() {
+    const size_t n = nodes_.size();
+    out_offsets_.assign(n + 1, 0);
+    in_offsets_.assign(n + 1, 0);
+    for (const auto& [a, b] : dir_) {
+        ++out_offsets_[a + 1];
+        ++in_offsets_[b + 1];
+    }
+    for (size_t i = 0; i < n; ++i) {
+        out_offsets_[i + 1] += out_offsets_[i];
+        in_offsets_[i + 1]  += in_offsets_[i];
+    }
+    out_edges_.resize(dir_.size());
+    in_edges_.resize(dir_.size());
+    vector<uint32_t> out_next(out_offsets_.begin(), out_offsets_.end() - 1);
+    vector<uint32_t> in_next(in_offsets_.begin(), in_offsets_.end() - 1);
+    for (const auto& [a, b] : dir_) {
+        out_edges_[out_next[a]++] = b;
+        in_edges_[in_next[b]++]   = a;
+    }
 }
 
 // bfs: returns node indices in visit order from 'start'
 vector<size_t> Graph::bfs(size_t start) const {
     vector<size_t> order;
-    vector<char>   seen(nodes_.size());
+    if (start >= out_offsets_.size() - 1) return order;
+    vector<char>   seen(out_offsets_.size() - 1);
     queue<size_t>  q;
     seen[start] = 1; q.push(start);
 
     while (!q.empty()) {
         size_t u = q.front(); q.pop();
         order.push_back(u);
-        for (auto &nbr : nodes_[u].adjacent()) {
-            size_t v = &nbr.get() - &nodes_[0];
-            if (!seen[v]) {
-                seen[v] = 1;
-                q.push(v);
+        for (auto edges : {out_edges(u), in_edges(u)}) {
+            for (uint32_t v : edges) {
+                if (!seen[v]) {
+                    seen[v] = 1;
+                    q.push(v);
+                }
             }
         }
     }
@@ -46,21 +73,23 @@ vector<size_t> Graph::bfs(size_t start) const {
 
 // shortest_path: unweighted BFS from src to dst, empty if none
 vector<size_t> Graph::shortest_path(size_t src, size_t target) const {
-    if (src >= nodes_.size() || target >= nodes_.size()) return {};
+    const size_t n = out_offsets_.size() - 1;
+    if (src >= n || target >= n) return {};
 
-    vector<int>    distance(nodes_.size(), -1);
-    vector<size_t> prev(nodes_.size());
+    vector<int>    distance(n, -1);
+    vector<size_t> prev(n);
     queue<size_t>  q;
 
     distance[src] = 0; q.push(src);
     while (!q.empty() && distance[target] == -1) {
         size_t u = q.front(); q.pop();
-        for (auto &nbr : nodes_[u].adjacent()) {
-            size_t v = &nbr.get() - &nodes_[0];
-            if (distance[v] == -1) {
-                distance[v] = distance[u] + 1;
-                prev[v]     = u;
-                q.push(v);
+        for (auto edges : {out_edges(u), in_edges(u)}) {
+            for (uint32_t v : edges) {
+                if (distance[v] == -1) {
+                    distance[v] = distance[u] + 1;
+                    prev[v]     = u;
+                    q.push(v);
+                }
             }
         }
     }
@@ -76,10 +105,11 @@ vector<size_t> Graph::shortest_path(size_t src, size_t target) const {
 
 // Graph constructed through BFS over references only (no citations) to build minimal graph
 // these IDs may be DOIs
-void Graph::graph_by_bfs(httplib::SSLClient& cli,
+void Graph::graph_by_bfs(ClientPool& pool,
              const string& start_id_in,
              const string& target_id_in)
 {
+    httplib::SSLClient& cli = pool[0]; // single requests go over the first pooled connection
     auto start_time = chrono::high_resolution_clock::now();
     // references only go from newer → older
     json start = get_work(cli, start_id_in);
@@ -88,37 +118,37 @@ void Graph::graph_by_bfs(httplib::SSLClient& cli,
     int year_start = start.value("publication_year", 0);
     int year_target = target.value("publication_year", 0);
 
-    string start_id = start["id"];
-    string target_id = target["id"];
+    WorkId start_id = WorkId::from_string(start.value("id", start_id_in));
+    WorkId target_id = WorkId::from_string(target.value("id", target_id_in));
 
     if (year_start < year_target) {
         cout << "Error: Start paper must be newer than end paper.\n";
         return;
     }
-    unordered_set<string> not_fetched;
-    unordered_map<string, unordered_set<string>> fetched_refs;
-    unordered_map<string, size_t> distance;
-    unordered_map<string, string> prev;
-    queue<string> q;
+    unordered_set<WorkId> not_fetched;
+    RefMap fetched_refs;
+    FlatMap<WorkId, size_t> distance(expected_nodes());
+    FlatMap<WorkId, WorkId> prev(expected_nodes());
+    queue<WorkId> q;
 
     // initialize
     distance[start_id] = 0;
     q.push(start_id);
     not_fetched.insert(start_id);
-    get_refs(cli, not_fetched, fetched_refs, year_target);
+    get_refs(pool, not_fetched, fetched_refs, year_target);
 
     size_t iter = 0;
     while (!q.empty()
            && !distance.count(target_id)
            && iter++ < max_size)
     {
-        string u = q.front(); q.pop();
+        WorkId u = q.front(); q.pop();
 
         if (not_fetched.contains(u))
-            get_refs(cli, not_fetched, fetched_refs, year_target);
+            get_refs(pool, not_fetched, fetched_refs, year_target);
 
         // traverse references only
-        for (auto &v : fetched_refs[u]) {
+        for (const WorkId v : fetched_refs[u]) {
             if (!distance.contains(v)) {
                 distance[v] = distance[u] + 1;
                 prev[v]     = u;
@@ -132,22 +162,891 @@ void Graph::graph_by_bfs(httplib::SSLClient& cli,
     if (!distance.contains(target_id))
         return;
 
-    // reconstruct ID path
-    vector<string> id_path;
-    for (string v = target_id; v != start_id; v = prev[v])
+    add_path(cli, prev, start_id, target_id);
+    auto end_time = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
+    cout << "Time elapsed: " << duration.count() << " ms" << endl;
+}
+
+// Level-synchronous BFS over references only, with the next level's references fetched in the background
+// while the current level is expanded; only blocks when a node's references have not arrived yet
+// works are expanded in the order they are found, so only the first max_size found are ever fetched
+// these IDs may be DOIs
+void Graph::graph_by_bfs_levels(ClientPool& pool,
+                                const string& start_id_in,
+                                const string& target_id_in)
+{
+    httplib::SSLClient& cli = pool[0];
+    auto start_time = chrono::high_resolution_clock::now();
+    // references only go from newer → older
+    json start = get_work(cli, start_id_in);
+    json target = get_work(cli, target_id_in);
+
+    int year_start = start.value("publication_year", 0);
+    int year_target = target.value("publication_year", 0);
+
+    WorkId start_id = WorkId::from_string(start.value("id", start_id_in));
+    WorkId target_id = WorkId::from_string(target.value("id", target_id_in));
+
+    if (year_start < year_target) {
+        cout << "Error: Start paper must be newer than end paper.\n";
+        return;
+    }
+    RefFetcher fetcher(pool, year_target);
+    FlatMap<WorkId, size_t> distance(expected_nodes());
+    FlatMap<WorkId, WorkId> prev(expected_nodes());
+    vector<WorkId> level;
+
+    // initialize
+    distance[start_id] = 0;
+    level.push_back(start_id);
+    fetcher.request(start_id);
+    fetcher.flush();
+    size_t requested = 1;
+
+    size_t iter = 0;
+    while (!level.empty()
+           && !distance.count(target_id)
+           && iter < max_size)
+    {
+        vector<WorkId> next_level;
+        for (const WorkId u : level) {
+            if (distance.count(target_id) || iter++ >= max_size) break;
+
+            // traverse references only; children are requested as soon as they are discovered
+            for (const WorkId v : fetcher.refs(u)) {
+                if (!distance.contains(v)) {
+                    distance[v] = distance[u] + 1;
+                    prev[v]     = u;
+                    next_level.push_back(v);
+                    if (v != target_id && requested < max_size) {
+                        fetcher.request(v);
+                        requested++;
+                    }
+                }
+            }
+        }
+        fetcher.flush();
+        level.swap(next_level);
+    }
+
+    // if no path found, leave graph empty
+    if (!distance.contains(target_id))
+        return;
+
+    add_path(cli, prev, start_id, target_id);
+    auto end_time = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
+    cout << "Time elapsed: " << duration.count() << " ms" << endl;
+}
+
+// Graph constructed through BFS from both ends: references forward from the start, citations backward from the target
+// each round expands the whole level of whichever side has the smaller frontier, and the search stops once they meet
+// these IDs may be DOIs
+void Graph::graph_by_bidirectional(ClientPool& pool,
+                                   const string& start_id_in,
+                                   const string& target_id_in)
+{
+    httplib::SSLClient& cli = pool[0];
+    auto start_time = chrono::high_resolution_clock::now();
+    // references only go from newer → older, citations from older → newer
+    json start = get_work(cli, start_id_in);
+    json target = get_work(cli, target_id_in);
+
+    int year_start = start.value("publication_year", 0);
+    int year_target = target.value("publication_year", 0);
+
+    WorkId start_id = WorkId::from_string(start.value("id", start_id_in));
+    WorkId target_id = WorkId::from_string(target.value("id", target_id_in));
+
+    if (year_start < year_target) {
+        cout << "Error: Start paper must be newer than end paper.\n";
+        return;
+    }
+    // forward side: distance from start and the work that references each one
+    FlatMap<WorkId, size_t> distance_f(expected_nodes());
+    FlatMap<WorkId, WorkId> prev(expected_nodes());
+    // backward side: distance to target and the work each one references on the way there
+    FlatMap<WorkId, size_t> distance_b(expected_nodes());
+    FlatMap<WorkId, WorkId> next(expected_nodes());
+    vector<WorkId> frontier_f{start_id};
+    vector<WorkId> frontier_b{target_id};
+    distance_f[start_id] = 0;
+    distance_b[target_id] = 0;
+
+    // best meeting point so far; a level is always finished so the shortest join through it is found
+    WorkId meet = distance_b.contains(start_id) ? start_id : WorkId();
+    size_t expanded = 0;
+    while (!meet
+           && !frontier_f.empty() && !frontier_b.empty()
+           && expanded < max_size)
+    {
+        size_t best = SIZE_MAX;
+        vector<WorkId> next_frontier;
+        if (frontier_f.size() <= frontier_b.size()) {
+            unordered_set<WorkId> not_fetched(frontier_f.begin(), frontier_f.end());
+            RefMap fetched_refs;
+            get_refs(pool, not_fetched, fetched_refs, year_target);
+            for (const WorkId u : frontier_f) {
+                // works whose batch failed go again with the next level, rather than pass for having no references
+                if (not_fetched.contains(u)) {
+                    next_frontier.push_back(u);
+                    continue;
+                }
+                for (const WorkId v : fetched_refs[u]) {
+                    if (distance_f.contains(v)) continue;
+                    distance_f[v] = distance_f[u] + 1;
+                    prev[v]       = u;
+                    next_frontier.push_back(v);
+                    auto b = distance_b.find(v);
+                    if (b != distance_b.end() && distance_f[v] + b->second < best) {
+                        best = distance_f[v] + b->second;
+                        meet = v;
+                    }
+                }
+            }
+            expanded += frontier_f.size();
+            frontier_f.swap(next_frontier);
+        } else {
+            RefMap citers;
+            const vector<WorkId> failed = get_citers(pool, frontier_b, citers, year_start);
+            const unordered_set<WorkId> unexpanded(failed.begin(), failed.end());
+            for (const WorkId v : frontier_b) {
+                // likewise for works whose citers did not all arrive
+                if (unexpanded.contains(v)) {
+                    next_frontier.push_back(v);
+                    continue;
+                }
+                for (const WorkId u : citers[v]) {
+                    if (distance_b.contains(u)) continue;
+                    distance_b[u] = distance_b[v] + 1;
+                    next[u]       = v;
+                    next_frontier.push_back(u);
+                    auto f = distance_f.find(u);
+                    if (f != distance_f.end() && f->second + distance_b[u] < best) {
+                        best = f->second + distance_b[u];
+                        meet = u;
+                    }
+                }
+            }
+            expanded += frontier_b.size();
+            frontier_b.swap(next_frontier);
+        }
+    }
+
+    // if no path found, leave graph empty
+    if (!meet)
+        return;
+
+    // start → meet along prev, then meet → target along next
+    vector<WorkId> id_path;
+    for (WorkId v = meet; v != start_id; v = prev.at(v))
         id_path.push_back(v);
     id_path.push_back(start_id);
     reverse(id_path.begin(), id_path.end());
+    for (WorkId v = meet; v != target_id; ) {
+        v = next.at(v);
+        id_path.push_back(v);
+    }
 
-    // fetch titles once for entire path
-    vector<string> titles = get_titles(cli, id_path);
+    add_path(cli, id_path);
+    auto end_time = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
+    cout << "Time elapsed: " << duration.count() << " ms" << endl;
+}
+
+// Graph constructed through A* over references only, ordered by a publication year lower bound
+// a reference never goes forward in time, and rarely goes back more than max_hop_years, so a work published
+// y years after the target is at least ceil(y / max_hop_years) hops from it; works are expanded lowest
+// hops so far + estimate first, and works older than the target or too far back to make it within max_depth
+// are never expanded
+// the estimate is exact only while no hop spans more than max_hop_years, so paths are optimal or near optimal
+// each round expands one best work per connection and fetches the years and references of all their
+// references at once, which the next round needs to rank them
+// these IDs may be DOIs
+void Graph::graph_by_astar(ClientPool& pool,
+                           const string& start_id_in,
+                           const string& target_id_in)
+{
+    httplib::SSLClient& cli = pool[0];
+    auto start_time = chrono::high_resolution_clock::now();
+    // references only go from newer → older
+    json start = get_work(cli, start_id_in);
+    json target = get_work(cli, target_id_in);
+
+    int year_start = start.value("publication_year", 0);
+    int year_target = target.value("publication_year", 0);
+
+    WorkId start_id = WorkId::from_string(start.value("id", start_id_in));
+    WorkId target_id = WorkId::from_string(target.value("id", target_id_in));
+
+    if (year_start < year_target) {
+        cout << "Error: Start paper must be newer than end paper.\n";
+        return;
+    }
+    // fewest hops from a work of year to the target
+    auto estimate = [&](const int year) -> size_t {
+        return (year - year_target + max_hop_years - 1) / max_hop_years;
+    };
+    FlatMap<WorkId, size_t> distance(expected_nodes());
+    FlatMap<WorkId, WorkId> prev(expected_nodes());
+    FlatSet<WorkId> closed(expected_nodes());
+    RefMap fetched_refs;
+    YearMap years;
+    // (hops + estimate, estimate, work): among equal totals, the work closer to the target goes first
+    using Entry = tuple<size_t, size_t, WorkId>;
+    priority_queue<Entry, vector<Entry>, greater<Entry>> open;
+
+    // initialize
+    unordered_set<WorkId> not_fetched{start_id};
+    get_refs(pool, not_fetched, fetched_refs, year_target, &years);
+    distance[start_id] = 0;
+    open.push({estimate(year_start), estimate(year_start), start_id});
 
-    // build local Graph nodes and edges along that path
-    this->add_node(id_path[0], titles[0]);
-    for (size_t i = 1; i < id_path.size(); ++i) {
-        this->add_node(id_path[i], titles[i]);
-        this->add_edge(id_path[i-1], id_path[i]);
+    size_t expanded = 0;
+    while (!open.empty()
+           && !closed.contains(target_id)
+           && expanded < max_size)
+    {
+        // the best works, one per connection; entries left behind by a shorter path are skipped
+        vector<WorkId> round;
+        while (!open.empty() && round.size() < pool.size()) {
+            const WorkId u = get<2>(open.top()); open.pop();
+            if (!closed.insert(u)) continue;
+            if (u == target_id) break;
+            round.push_back(u);
+        }
+        if (closed.contains(target_id)) break;
+        expanded += round.size();
+
+        // traverse references only; works reached by a shorter path than before are ranked again
+        vector<WorkId> relaxed;
+        for (const WorkId u : round) {
+            for (const WorkId v : fetched_refs[u]) {
+                if (closed.contains(v)) continue;
+                const size_t hops = distance[u] + 1;
+                auto it = distance.find(v);
+                if (it != distance.end() && it->second <= hops) continue;
+                if (it == distance.end() && !years.contains(v)) not_fetched.insert(v);
+                distance[v] = hops;
+                prev[v]     = u;
+                relaxed.push_back(v);
+            }
+        }
+        get_refs(pool, not_fetched, fetched_refs, year_target, &years);
+
+        // rank them; works that were not found, are older than the target, or are too old for the depth left are pruned
+        for (const WorkId v : relaxed) {
+            auto year = years.find(v);
+            if (year == years.end() || year->second < year_target) continue;
+            const size_t h = estimate(year->second);
+            if (distance[v] + h > max_depth) continue;
+            open.push({distance[v] + h, h, v});
+        }
     }
+
+    // if no path found, leave graph empty
+    if (!closed.contains(target_id))
+        return;
+
+    add_path(cli, prev, start_id, target_id);
+    auto end_time = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
+    cout << "Time elapsed: " << duration.count() << " ms" << endl;
+}
+
+// batched reference fetching through the API for searches run level by level, into fetched_refs; a work is
+// marked fetched once it has come back, so it is fetched once
+static RefPrefetch api_prefetch(ClientPool& pool, const int year_target, RefMap& fetched_refs, FlatSet<WorkId>& fetched) {
+    return [&pool, year_target, &fetched_refs, &fetched](const vector<WorkId>& level) {
+        unordered_set<WorkId> not_fetched;
+        for (const WorkId u : level) {
+            if (!fetched.contains(u)) not_fetched.insert(u);
+        }
+        get_refs(pool, not_fetched, fetched_refs, year_target);
+        // works of a failed batch are left unmarked, so the next level that reaches them asks again
+        for (const WorkId u : level) {
+            if (!not_fetched.contains(u)) fetched.insert(u);
+        }
+    };
+}
+
+// references in the local graph to works not older than the target, read from u's edge list into a buffer the
+// result points into until the next call; nothing is kept per work, so searches over the local graph cost what
+// local_bfs does
+static auto local_refs(const GraphOverlay& local, const int year_target) {
+    return [&local, year_target, edges = vector<uint32_t>(), refs = vector<uint32_t>()](const uint32_t u) mutable
+               -> const vector<uint32_t>& {
+        refs.clear();
+        for (const uint32_t v : local.out_edges(u, edges)) {
+            if (local.year(v) >= year_target) refs.push_back(v);
+        }
+        return refs;
+    };
+}
+
+// start and target of a search over the local graph, or npos if either is not in it; IDs that are not W-numbers
+// are resolved through the API
+static pair<uint32_t, uint32_t> resolve_local(const GraphOverlay& local, httplib::SSLClient& cli,
+                                              const string& start_id_in, const string& target_id_in) {
+    auto resolve = [&](const string& id_in) {
+        WorkId id = WorkId::parse(id_in);
+        if (!id) id = WorkId::parse(get_work(cli, id_in).value("id", ""));
+        return local.find(id);
+    };
+    return {resolve(start_id_in), resolve(target_id_in)};
+}
+
+// direction optimizing bfs switches to a bottom-up step once the frontier's references outnumber the citations
+// of the works not yet visited by this factor, and back to top-down once the frontier is smaller than this
+// fraction of the graph (the values suggested by Beamer et al.)
+static constexpr uint64_t bottom_up_edge_factor = 14;
+static constexpr uint64_t top_down_node_fraction = 24;
+
+// path start … target found by a bfs over references, or empty if there is none; works older than year_target
+// are not followed
+// a level is expanded top-down, through the frontier's references, while the frontier is small; once it
+// reaches hub papers most of those references point at visited works, so levels are instead expanded
+// bottom-up: every unvisited work checks its citations against a bitmap of the frontier, and stops at the first hit
+static vector<uint32_t> local_bfs(const GraphOverlay& local,
+                                  const uint32_t start,
+                                  const uint32_t target,
+                                  const int year_target,
+                                  const size_t expected_nodes)
+{
+    const uint32_t n = local.node_count();
+    const size_t words = (static_cast<size_t>(n) + 63) / 64;
+    auto test = [](const vector<uint64_t>& bits, const uint32_t v) { return (bits[v >> 6] >> (v & 63)) & 1; };
+    auto set  = [](vector<uint64_t>& bits, const uint32_t v) { bits[v >> 6] |= uint64_t(1) << (v & 63); };
+
+    FlatMap<uint32_t, uint32_t> prev(expected_nodes);
+    vector<uint64_t> visited(words);
+    vector<uint64_t> frontier_bits;
+    vector<uint32_t> frontier{start};
+    vector<uint32_t> edges; // compressed edge lists are decoded in here
+    // citations a bottom-up step would check: those of every unvisited work
+    uint64_t unvisited_edges = local.edge_count();
+    auto visit = [&](const uint32_t v, const uint32_t parent, vector<uint32_t>& next) {
+        set(visited, v);
+        prev[v] = parent;
+        next.push_back(v);
+        unvisited_edges -= min(unvisited_edges, local.in_degree(v));
+    };
+
+    // initialize
+    set(visited, start);
+    prev[start] = start;
+
+    bool bottom_up = false;
+    while (!frontier.empty() && !test(visited, target)) {
+        if (!bottom_up) {
+            uint64_t frontier_edges = 0;
+            for (const uint32_t u : frontier) frontier_edges += local.out_degree(u);
+            bottom_up = frontier_edges > unvisited_edges / bottom_up_edge_factor;
+        } else {
+            bottom_up = frontier.size() >= n / top_down_node_fraction;
+        }
+
+        vector<uint32_t> next;
+        if (!bottom_up) {
+            // traverse references only, skipping works older than the target
+            for (const uint32_t u : frontier) {
+                for (const uint32_t v : local.out_edges(u, edges)) {
+                    if (local.year(v) >= year_target && !test(visited, v)) visit(v, u, next);
+                }
+            }
+        } else {
+            frontier_bits.assign(words, 0);
+            for (const uint32_t u : frontier) set(frontier_bits, u);
+            for (size_t w = 0; w < words; ++w) {
+                uint64_t unvisited = ~visited[w];
+                if (w == words - 1 && n % 64) unvisited &= (uint64_t(1) << (n % 64)) - 1;
+                for (; unvisited; unvisited &= unvisited - 1) {
+                    const uint32_t v = static_cast<uint32_t>(w * 64 + countr_zero(unvisited));
+                    if (local.year(v) < year_target) continue;
+                    for (const uint32_t u : local.in_edges(v, edges)) {
+                        if (test(frontier_bits, u)) {
+                            visit(v, u, next);
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        frontier.swap(next);
+    }
+
+    vector<uint32_t> path;
+    if (!test(visited, target)) return path;
+    for (uint32_t v = target; v != start; v = prev.at(v))
+        path.push_back(v);
+    path.push_back(start);
+    reverse(path.begin(), path.end());
+    return path;
+}
+
+// multithreaded local_bfs, for graphs of hundreds of millions of works; same directions, same switches
+// - a level's frontier (or, bottom-up, the visited bitmap) is cut into chunks that threads claim from a shared
+//   cursor whenever they finish one, so a thread held up by a hub's long list leaves the rest to the others
+// - each thread collects the works it visits in its own next frontier
+// - top-down, a work goes to whichever thread wins a compare-and-swap on its parent; an atomic visited bitmap
+//   in front of that turns most edges to visited works away with a plain read instead of a failed CAS
+// parents take 4 bytes for every work in the graph, where local_bfs only keeps those of visited works; they and the
+// visited bitmap are kept for the next search, which then only clears what this one set, so a search costs what it
+// visits rather than what the graph holds
+struct ParallelBfsState {
+    vector<atomic<uint64_t>> visited;
+    vector<atomic<uint32_t>> parent; // parent + 1, 0 while unvisited
+};
+static mutex parallel_bfs_mutex;
+static vector<unique_ptr<ParallelBfsState>> idle_parallel_bfs; // one per search that ran at the same time as others
+
+static vector<uint32_t> parallel_local_bfs(const GraphOverlay& local,
+                                           const uint32_t start,
+                                           const uint32_t target,
+                                           const int year_target,
+                                           const size_t threads)
+{
+    constexpr size_t frontier_chunk = 256; // works
+    constexpr size_t bitmap_chunk = 64;    // words of the visited bitmap, i.e. 4096 works
+
+    const uint32_t n = local.node_count();
+    const size_t words = (static_cast<size_t>(n) + 63) / 64;
+    unique_ptr<ParallelBfsState> state;
+    {
+        lock_guard<mutex> lock(parallel_bfs_mutex);
+        if (!idle_parallel_bfs.empty()) {
+            state = move(idle_parallel_bfs.back());
+            idle_parallel_bfs.pop_back();
+        }
+    }
+    if (!state) state = make_unique<ParallelBfsState>();
+    // only a graph that grew needs them allocated again
+    if (state->parent.size() < n) {
+        state->visited = vector<atomic<uint64_t>>(words);
+        state->parent = vector<atomic<uint32_t>>(n);
+    }
+    vector<atomic<uint64_t>>& visited = state->visited;
+    vector<atomic<uint32_t>>& parent = state->parent;
+    vector<uint64_t> frontier_bits;
+    vector<uint32_t> frontier{start};
+    vector<uint32_t> reached{start}; // every work visited, whose slots are cleared at the end
+
+    struct alignas(64) Local {
+        vector<uint32_t> next;
+        vector<uint32_t> edges;          // compressed edge lists are decoded in here
+        uint64_t         next_edges = 0; // references of next
+        uint64_t         next_in = 0;    // citations of next
+    };
+    vector<Local> locals(threads);
+    auto visit = [&](const uint32_t v, Local& l) {
+        l.next.push_back(v);
+        l.next_edges += local.out_degree(v);
+        l.next_in += local.in_degree(v);
+    };
+    // runs body(chunk, local) for chunks 0..chunks-1 on every thread
+    auto run_level = [&](const size_t chunks, const auto& body) {
+        atomic<size_t> cursor = 0;
+        auto work = [&](const size_t t) {
+            for (size_t c; (c = cursor.fetch_add(1, memory_order_relaxed)) < chunks; ) body(c, locals[t]);
+        };
+        vector<thread> team;
+        for (size_t t = 1; t < min(threads, chunks); t++) team.emplace_back(work, t);
+        work(0);
+        for (auto& member : team) member.join();
+    };
+
+    // initialize
+    visited[start >> 6] |= uint64_t(1) << (start & 63);
+    parent[start] = start + 1;
+    uint64_t frontier_edges = local.out_degree(start);
+    uint64_t unvisited_edges = local.edge_count();
+
+    bool bottom_up = false;
+    while (!frontier.empty() && !parent[target].load(memory_order_relaxed)) {
+        bottom_up = bottom_up ? frontier.size() >= n / top_down_node_fraction
+                              : frontier_edges > unvisited_edges / bottom_up_edge_factor;
+
+        if (!bottom_up) {
+            // traverse references only, skipping works older than the target
+            run_level((frontier.size() + frontier_chunk - 1) / frontier_chunk, [&](const size_t c, Local& l) {
+                const size_t end = min(frontier.size(), (c + 1) * frontier_chunk);
+                for (size_t i = c * frontier_chunk; i < end; i++) {
+                    const uint32_t u = frontier[i];
+                    for (const uint32_t v : local.out_edges(u, l.edges)) {
+                        const uint64_t bit = uint64_t(1) << (v & 63);
+                        if (visited[v >> 6].load(memory_order_relaxed) & bit) continue;
+                        if (local.year(v) < year_target) continue;
+                        uint32_t none = 0;
+                        if (!parent[v].compare_exchange_strong(none, u + 1, memory_order_relaxed)) continue;
+                        visited[v >> 6].fetch_or(bit, memory_order_relaxed);
+                        visit(v, l);
+                    }
+                }
+            });
+        } else {
+            frontier_bits.assign(words, 0);
+            for (const uint32_t u : frontier) frontier_bits[u >> 6] |= uint64_t(1) << (u & 63);
+            // each chunk's works are only visited by the thread that claimed it, so no CAS is needed
+            run_level((words + bitmap_chunk - 1) / bitmap_chunk, [&](const size_t c, Local& l) {
+                const size_t end = min(words, (c + 1) * bitmap_chunk);
+                for (size_t w = c * bitmap_chunk; w < end; w++) {
+                    uint64_t unvisited = ~visited[w].load(memory_order_relaxed);
+                    if (w == words - 1 && n % 64) unvisited &= (uint64_t(1) << (n % 64)) - 1;
+                    for (; unvisited; unvisited &= unvisited - 1) {
+                        const uint32_t v = static_cast<uint32_t>(w * 64 + countr_zero(unvisited));
+                        if (local.year(v) < year_target) continue;
+                        for (const uint32_t u : local.in_edges(v, l.edges)) {
+                            if ((frontier_bits[u >> 6] >> (u & 63)) & 1) {
+                                parent[v].store(u + 1, memory_order_relaxed);
+                                visited[w].fetch_or(uint64_t(1) << (v & 63), memory_order_relaxed);
+                                visit(v, l);
+                                break;
+                            }
+                        }
+                    }
+                }
+            });
+        }
+
+        // gather the threads' frontiers
+        frontier.clear();
+        frontier_edges = 0;
+        for (auto& l : locals) {
+            frontier.insert(frontier.end(), l.next.begin(), l.next.end());
+            frontier_edges += l.next_edges;
+            unvisited_edges -= min(unvisited_edges, l.next_in);
+            l.next.clear();
+            l.next_edges = l.next_in = 0;
+        }
+        reached.insert(reached.end(), frontier.begin(), frontier.end());
+    }
+
+    vector<uint32_t> path;
+    if (parent[target].load()) {
+        for (uint32_t v = target; v != start; v = parent[v].load() - 1)
+            path.push_back(v);
+        path.push_back(start);
+        reverse(path.begin(), path.end());
+    }
+
+    for (const uint32_t v : reached) {
+        parent[v].store(0, memory_order_relaxed);
+        visited[v >> 6].store(0, memory_order_relaxed);
+    }
+    lock_guard<mutex> lock(parallel_bfs_mutex);
+    idle_parallel_bfs.push_back(move(state));
+    return path;
+}
+
+// Graph constructed through BFS over references only, entirely in the local graph built by Ingest (with its delta)
+// the bfs is direction optimizing, see local_bfs; with threads > 1 each level is expanded on that many threads
+// only the path's titles are looked up through cli (from the cache when offline)
+// these IDs may be DOIs; those are resolved through the API
+void Graph::graph_by_local_bfs(const GraphOverlay& local,
+                               httplib::SSLClient& cli,
+                               const string& start_id_in,
+                               const string& target_id_in,
+                               const size_t threads)
+{
+    auto start_time = chrono::high_resolution_clock::now();
+    const auto [start, target] = resolve_local(local, cli, start_id_in, target_id_in);
+    if (start == GraphOverlay::npos || target == GraphOverlay::npos) {
+        cout << "Error: Paper not in local graph.\n";
+        return;
+    }
+
+    // references only go from newer → older
+    const int year_target = local.year(target);
+    if (local.year(start) < year_target) {
+        cout << "Error: Start paper must be newer than end paper.\n";
+        return;
+    }
+    const vector<uint32_t> path = threads > 1 ? parallel_local_bfs(local, start, target, year_target, threads)
+                                              : local_bfs(local, start, target, year_target, expected_nodes());
+
+    // if no path found, leave graph empty
+    if (path.empty())
+        return;
+
+    vector<WorkId> id_path;
+    for (const uint32_t v : path)
+        id_path.push_back(local.id(v));
+
+    add_path(cli, id_path);
+    auto end_time = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
+    cout << "Time elapsed: " << duration.count() << " ms" << endl;
+}
+
+// bfs state shared by the spur searches of one k shortest paths search: each search clears the entries the last
+// one added, by their keys in visited, instead of allocating a map of its own or clearing all of a large one
+// the tree itself cannot be reused between spurs, as each blocks a different part of the path before it
+template <typename Node>
+struct SpurSearch {
+    FlatMap<Node, Node> prev;
+    vector<Node>        visited;
+    vector<Node>        level;
+    vector<Node>        next_level;
+};
+
+// shortest path spur → target of at most max_hops hops by bfs, avoiding the works in blocked and the references
+// from spur to works in cut; empty if there is none
+// at most budget works are expanded, and no more than total, which counts down the works every spur search of
+// the k shortest paths search expands
+// Node is a WorkId over the API, whose refs(u) are fetched a level at a time by prefetch, and a node index over
+// the local graph, whose refs(u) read its edge lists directly
+template <typename Node, typename Prefetch, typename Refs>
+static vector<Node> spur_path(const Node spur,
+                              const Node target,
+                              const FlatSet<Node>& blocked,
+                              const FlatSet<Node>& cut,
+                              const size_t max_hops,
+                              size_t budget,
+                              size_t& total,
+                              const Prefetch& prefetch,
+                              Refs& refs,
+                              SpurSearch<Node>& search)
+{
+    auto& [prev, visited, level, next_level] = search;
+    prev.clear(visited);
+    visited.assign(1, spur);
+    level.assign(1, spur);
+    prev[spur] = spur;
+    budget = min(budget, total);
+    for (size_t hops = 0; hops < max_hops && !level.empty() && budget && !prev.contains(target); ++hops) {
+        // the works past the budget are neither fetched nor expanded
+        if (level.size() > budget) level.resize(budget);
+        budget -= level.size();
+        total -= level.size();
+        prefetch(level);
+        next_level.clear();
+        for (const Node u : level) {
+            for (const Node v : refs(u)) {
+                if (prev.contains(v) || blocked.contains(v) || (u == spur && cut.contains(v))) continue;
+                prev[v] = u;
+                visited.push_back(v);
+                next_level.push_back(v);
+            }
+        }
+        level.swap(next_level);
+    }
+
+    vector<Node> path;
+    if (!prev.contains(target)) return path;
+    for (Node v = target; v != spur; v = prev.at(v))
+        path.push_back(v);
+    path.push_back(spur);
+    reverse(path.begin(), path.end());
+    return path;
+}
+
+// Yen's k shortest loopless paths start → target: each new path is the shortest of the candidates found by
+// leaving the previous one at one of its works (the spur) for a path that avoids the part before the spur and
+// every earlier path's next hop from the same root
+// the searches share one reference lookup, so every work's references are fetched once however many spur
+// searches pass it; and, as Lawler noticed, a path need only be left at or after the work where it left its
+// own parent, since candidates spurring earlier were already found from the parent
+// each spur search expands at most spur_size works, and all of them together at most total_size
+template <typename Node, typename Prefetch, typename Refs>
+static vector<vector<Node>> k_shortest_paths(const Node start,
+                                             const Node target,
+                                             const size_t k,
+                                             const size_t max_hops,
+                                             const size_t spur_size,
+                                             size_t total_size,
+                                             const Prefetch& prefetch,
+                                             Refs& refs,
+                                             const size_t expected_nodes)
+{
+    vector<vector<Node>> paths;
+    vector<size_t> deviations; // where each path left its parent
+    SpurSearch<Node> search{FlatMap<Node, Node>(expected_nodes)};
+    vector<Node> first = spur_path(start, target, {}, {}, max_hops, spur_size, total_size, prefetch, refs, search);
+    if (first.empty()) return paths;
+    paths.push_back(move(first));
+    deviations.push_back(0);
+
+    // (hops, order found, candidate): shortest first, ties in the order they were found
+    vector<pair<vector<Node>, size_t>> candidates;
+    using Entry = tuple<size_t, size_t, size_t>;
+    priority_queue<Entry, vector<Entry>, greater<Entry>> best;
+    set<vector<Node>> known{paths[0]};
+
+    while (paths.size() < k && total_size) {
+        const vector<Node> last = paths.back();
+        for (size_t i = deviations.back(); i + 1 < last.size() && total_size; ++i) {
+            const Node spur = last[i];
+            FlatSet<Node> blocked;
+            for (size_t j = 0; j < i; ++j) blocked.insert(last[j]);
+            FlatSet<Node> cut;
+            for (const auto& path : paths) {
+                if (path.size() > i + 1 && equal(last.begin(), last.begin() + i + 1, path.begin()))
+                    cut.insert(path[i + 1]);
+            }
+
+            vector<Node> tail = spur_path(spur, target, blocked, cut, max_hops - i, spur_size, total_size,
+                                          prefetch, refs, search);
+            if (tail.empty()) continue;
+            vector<Node> candidate(last.begin(), last.begin() + i);
+            candidate.insert(candidate.end(), tail.begin(), tail.end());
+            if (!known.insert(candidate).second) continue;
+            best.push({candidate.size(), candidates.size(), candidates.size()});
+            candidates.push_back({move(candidate), i});
+        }
+        if (best.empty()) break;
+
+        const size_t next = get<2>(best.top()); best.pop();
+        paths.push_back(move(candidates[next].first));
+        deviations.push_back(candidates[next].second);
+    }
+    return paths;
+}
+
+// the k shortest paths over references, through the API; each spur search fetches its bfs levels in batches
+// and expands at most max_size works, and all of them together at most k times that
+// these IDs may be DOIs
+void Graph::graph_by_k_paths(ClientPool& pool,
+                             const string& start_id_in,
+                             const string& target_id_in,
+                             const size_t k)
+{
+    httplib::SSLClient& cli = pool[0];
+    auto start_time = chrono::high_resolution_clock::now();
+    // references only go from newer → older
+    json start = get_work(cli, start_id_in);
+    json target = get_work(cli, target_id_in);
+
+    int year_start = start.value("publication_year", 0);
+    int year_target = target.value("publication_year", 0);
+
+    WorkId start_id = WorkId::from_string(start.value("id", start_id_in));
+    WorkId target_id = WorkId::from_string(target.value("id", target_id_in));
+
+    if (year_start < year_target) {
+        cout << "Error: Start paper must be newer than end paper.\n";
+        return;
+    }
+    RefMap fetched_refs;
+    FlatSet<WorkId> fetched(expected_nodes());
+    auto refs = [&](const WorkId u) -> const vector<WorkId>& { return fetched_refs[u]; };
+
+    // each spur search is held to graph_by_bfs's limits, and all of them to those of k such searches
+    vector<vector<WorkId>> id_paths = k_shortest_paths(start_id, target_id, k, max_depth, max_size, max_size * k,
+                                                       api_prefetch(pool, year_target, fetched_refs, fetched), refs,
+                                                       expected_nodes());
+    if (id_paths.empty())
+        return;
+
+    add_paths(cli, id_paths);
+    auto end_time = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
+    cout << "Time elapsed: " << duration.count() << " ms" << endl;
+}
+
+// the k shortest paths over references in the local graph built by Ingest (with its delta), held to the
+// expansion limits of graph_by_k_paths
+// only the paths' titles are looked up through cli
+// these IDs may be DOIs; those are resolved through the API
+void Graph::graph_by_local_k_paths(const GraphOverlay& local,
+                                   httplib::SSLClient& cli,
+                                   const string& start_id_in,
+                                   const string& target_id_in,
+                                   const size_t k)
+{
+    auto start_time = chrono::high_resolution_clock::now();
+    const auto [start, target] = resolve_local(local, cli, start_id_in, target_id_in);
+    if (start == GraphOverlay::npos || target == GraphOverlay::npos) {
+        cout << "Error: Paper not in local graph.\n";
+        return;
+    }
+
+    // references only go from newer → older
+    const int year_target = local.year(target);
+    if (local.year(start) < year_target) {
+        cout << "Error: Start paper must be newer than end paper.\n";
+        return;
+    }
+    auto refs = local_refs(local, year_target);
+    const vector<vector<uint32_t>> paths = k_shortest_paths(start, target, k, SIZE_MAX, max_size, max_size * k,
+                                                            [](const vector<uint32_t>&) {}, refs, expected_nodes());
+    if (paths.empty())
+        return;
+
+    vector<vector<WorkId>> id_paths;
+    for (const auto& path : paths) {
+        id_paths.emplace_back();
+        for (const uint32_t v : path) id_paths.back().push_back(local.id(v));
+    }
+
+    add_paths(cli, id_paths);
+    auto end_time = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
+    cout << "Time elapsed: " << duration.count() << " ms" << endl;
+}
+
+// every shortest path over references, through the API, as a PathDag built in one bfs of at most max_size
+// expanded works; path_count() is set to their number and the first max_paths of them are added to the graph
+// these IDs may be DOIs
+void Graph::graph_by_path_dag(ClientPool& pool,
+                              const string& start_id_in,
+                              const string& target_id_in,
+                              const size_t max_paths)
+{
+    httplib::SSLClient& cli = pool[0];
+    auto start_time = chrono::high_resolution_clock::now();
+    // references only go from newer → older
+    json start = get_work(cli, start_id_in);
+    json target = get_work(cli, target_id_in);
+
+    int year_start = start.value("publication_year", 0);
+    int year_target = target.value("publication_year", 0);
+
+    WorkId start_id = WorkId::from_string(start.value("id", start_id_in));
+    WorkId target_id = WorkId::from_string(target.value("id", target_id_in));
+
+    if (year_start < year_target) {
+        cout << "Error: Start paper must be newer than end paper.\n";
+        return;
+    }
+    RefMap fetched_refs;
+    FlatSet<WorkId> fetched(expected_nodes());
+    auto refs = [&](const WorkId u) -> const vector<WorkId>& { return fetched_refs[u]; };
+    PathDag dag = PathDag::build(start_id, target_id, max_depth, max_size, api_prefetch(pool, year_target, fetched_refs, fetched),
+                                 refs, expected_nodes());
+    add_dag_paths(cli, dag, max_paths);
+
+    auto end_time = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
+    cout << "Time elapsed: " << duration.count() << " ms" << endl;
+}
+
+// as graph_by_path_dag, over the local graph built by Ingest (with its delta), with the same limit of max_size
+// expanded works
+// these IDs may be DOIs; those are resolved through the API
+void Graph::graph_by_local_path_dag(const GraphOverlay& local,
+                                    httplib::SSLClient& cli,
+                                    const string& start_id_in,
+                                    const string& target_id_in,
+                                    const size_t max_paths)
+{
+    auto start_time = chrono::high_resolution_clock::now();
+    const auto [start, target] = resolve_local(local, cli, start_id_in, target_id_in);
+    if (start == GraphOverlay::npos || target == GraphOverlay::npos) {
+        cout << "Error: Paper not in local graph.\n";
+        return;
+    }
+
+    // references only go from newer → older
+    const int year_target = local.year(target);
+    if (local.year(start) < year_target) {
+        cout << "Error: Start paper must be newer than end paper.\n";
+        return;
+    }
+    PathDag dag = PathDag::build(start, target, SIZE_MAX, max_size, local_refs(local, year_target),
+                                 [&](const uint32_t v) { return local.id(v); }, expected_nodes());
+    add_dag_paths(cli, dag, max_paths);
+
     auto end_time = chrono::high_resolution_clock::now();
     auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
     cout << "Time elapsed: " << duration.count() << " ms" << endl;
@@ -173,29 +1072,28 @@ void Graph::graph_by_befs(httplib::SSLClient& cli,
         return;
     }
 
-    json start_concepts = start["concepts"];
-    size_t start_num_refs = start["referenced_works"].size();
+    WorkRecord start_rec = WorkRecord::from_json(start);
 
-    unordered_map<string, float> target_concepts;
-    for (const auto& concept_j : target["concepts"])
-        target_concepts.emplace(concept_j["id"], concept_j.value("score", 0.0f));
+    unordered_map<uint64_t, float> target_concepts;
+    for (const auto& c : WorkRecord::from_json(target).concepts)
+        target_concepts.emplace(c.id, c.score);
 
-    string start_id = start["id"];
-    string target_id = target["id"];
-    float start_h = get_heuristic(start_concepts, start_num_refs, target_concepts);
+    WorkId start_id = WorkId::from_string(start.value("id", start_id_in));
+    WorkId target_id = WorkId::from_string(target.value("id", target_id_in));
+    float start_h = get_heuristic(start_rec.concepts, target_concepts);
 
-    auto cmp_heuristic = [](const pair<float, string>& left, const pair<float, string>& right) {
+    auto cmp_heuristic = [](const pair<float, WorkId>& left, const pair<float, WorkId>& right) {
         return left.first < right.first;
     };
 
-    unordered_map<string, size_t> distance;
-    unordered_map<string, string> prev;
-    unordered_map<string, size_t> depth_from_start;
-    unordered_set<string> visited;
+    FlatMap<WorkId, size_t> distance(expected_nodes());
+    FlatMap<WorkId, WorkId> prev(expected_nodes());
+    FlatMap<WorkId, size_t> depth_from_start(expected_nodes());
+    FlatSet<WorkId> visited(expected_nodes());
 
     priority_queue<
-        pair<float, string>,
-        vector<pair<float, string>>,
+        pair<float, WorkId>,
+        vector<pair<float, WorkId>>,
         decltype(cmp_heuristic)
     > q(cmp_heuristic);
 
@@ -238,23 +1136,68 @@ void Graph::graph_by_befs(httplib::SSLClient& cli,
 
     if (!distance.count(target_id)) return;
 
-    // Reconstruct ID path
-    vector<string> id_path;
-    for (string v = target_id; v != start_id; v = prev[v])
+    add_path(cli, prev, start_id, target_id);
+
+    auto end_time = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
+    cout << "Time elapsed: " << duration.count() << " ms" << endl;
+}
+
+// reconstructs the start → target path from prev and adds its nodes and edges, fetching titles once
+void Graph::add_path(httplib::SSLClient& cli,
+                     const FlatMap<WorkId,WorkId>& prev,
+                     const WorkId start_id,
+                     const WorkId target_id)
+{
+    // reconstruct ID path
+    vector<WorkId> id_path;
+    for (WorkId v = target_id; v != start_id; v = prev.at(v))
         id_path.push_back(v);
     id_path.push_back(start_id);
     reverse(id_path.begin(), id_path.end());
+    add_path(cli, id_path);
+}
 
-    // Fetch titles once
-    vector<string> titles = get_titles(cli, id_path);
-    this->add_node(id_path[0], titles[0]);
+// adds the nodes and edges of a start → target ID path, fetching titles once
+void Graph::add_path(httplib::SSLClient& cli, const vector<WorkId>& id_path) {
+    add_paths(cli, {id_path});
+}
+
+// records the number of paths in dag and adds the first max_paths of them
+void Graph::add_dag_paths(httplib::SSLClient& cli, const PathDag& dag, const size_t max_paths) {
+    path_count_ = dag.count();
+    vector<vector<WorkId>> id_paths;
+    vector<WorkId> id_path;
+    for (auto paths = dag.paths(); id_paths.size() < max_paths && paths.next(id_path); )
+        id_paths.push_back(id_path);
+    if (!id_paths.empty())
+        add_paths(cli, id_paths);
+}
 
-    for (size_t i = 1; i < id_path.size(); ++i) {
-        this->add_node(id_path[i], titles[i]);
-        this->add_edge(id_path[i - 1], id_path[i]);
+// adds the nodes and edges of several start → target ID paths, fetching the titles of all their works at once
+void Graph::add_paths(httplib::SSLClient& cli, const vector<vector<WorkId>>& id_paths) {
+    vector<WorkId> ids;
+    FlatSet<WorkId> seen;
+    for (const auto& id_path : id_paths) {
+        for (const WorkId id : id_path) {
+            if (seen.insert(id)) ids.push_back(id);
+        }
     }
+    // fetch titles once for every work on the paths
+    vector<string> titles = get_titles(cli, ids);
 
-    auto end_time = chrono::high_resolution_clock::now();
-    auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
-    cout << "Time elapsed: " << duration.count() << " ms" << endl;
+    // build local Graph nodes and edges along the paths, each shared edge once
+    for (size_t i = 0; i < ids.size(); ++i)
+        this->add_node(ids[i], titles[i]);
+    FlatSet<uint64_t> edges;
+    for (const auto& id_path : id_paths) {
+        vector<size_t> path{idx_.at(id_path[0])};
+        for (size_t i = 1; i < id_path.size(); ++i) {
+            path.push_back(idx_.at(id_path[i]));
+            if (edges.insert(uint64_t(path[i-1]) << 32 | path[i]))
+                this->add_edge(id_path[i-1], id_path[i]);
+        }
+        paths_.push_back(move(path));
+    }
+    finalize();
 }
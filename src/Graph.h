@@ -7,40 +7,84 @@
 #include <functional>
 #include <queue>
 #include <algorithm>
+#include <span>
+#include "FlatMap.h"
 #include "openalex.h"
+#include "GraphOverlay.h"
+#include "PathDag.h"
 
 using namespace std;
 
 // represents one OpenAlex paper in the graph
 struct Node {
-    Node(string id, string title) : id_(move(id)), title_(move(title)) {}
-    const string &get_id()    const { return id_; }
+    Node(WorkId id, string title) : id_(id), title_(move(title)) {}
+    string        get_id()    const { return id_.to_string(); }
+    WorkId        work_id()   const { return id_; }
     const string &get_title() const { return title_; }
-    const vector<reference_wrapper<Node>> &adjacent() const { return nbr_; }
 private:
-    string id_, title_;
-    vector<reference_wrapper<Node>> nbr_;
-    friend class Graph;
+    WorkId id_;
+    string title_;
 };
 
-// adjacency‑list graph, stores directed edges for rendering
+// directed graph for rendering, built in two phases: add_node/add_edge collect nodes and edges,
+// then finalize() lays the edges out in compressed sparse row form, as out- and in-edge ranges of
+// 32-bit node indices; traversals use the edges as of the last finalize()
 class Graph {
 public:
-    size_t add_node(const string &id, const string &title);
-    void   add_edge(const string &from_id, const string &to_id);
+    size_t add_node(WorkId id, const string &title);
+    void   add_edge(WorkId from_id, WorkId to_id);
+    void   finalize();
+    // nodes u links to, and nodes linking to u, in the order the edges were added
+    span<const uint32_t> out_edges(size_t u) const { return {out_edges_.data() + out_offsets_[u], out_edges_.data() + out_offsets_[u + 1]}; }
+    span<const uint32_t> in_edges(size_t u)  const { return {in_edges_.data() + in_offsets_[u], in_edges_.data() + in_offsets_[u + 1]}; }
+    // both follow edges in either direction
     vector<size_t> bfs(size_t start) const;
     vector<size_t> shortest_path(size_t src, size_t dst) const;
-    void  graph_by_bfs(httplib::SSLClient& cli, const string &start_id_in, const string &target_id_in);
+    void  graph_by_bfs(ClientPool& pool, const string &start_id_in, const string &target_id_in);
+    void  graph_by_bfs_levels(ClientPool& pool, const string &start_id_in, const string &target_id_in);
+    void  graph_by_bidirectional(ClientPool& pool, const string &start_id_in, const string &target_id_in);
+    void  graph_by_astar(ClientPool& pool, const string &start_id_in, const string &target_id_in);
+    void  graph_by_local_bfs(const GraphOverlay& local, httplib::SSLClient& cli, const string &start_id_in, const string &target_id_in, size_t threads = 1);
     void  graph_by_befs(httplib::SSLClient& cli, const string &start_id_in, const string &target_id_in);
+    // the k shortest loopless paths (Yen's algorithm), over the API or over the local graph; all of them are
+    // added to the graph and listed, shortest first, in paths()
+    void  graph_by_k_paths(ClientPool& pool, const string &start_id_in, const string &target_id_in, size_t k);
+    void  graph_by_local_k_paths(const GraphOverlay& local, httplib::SSLClient& cli, const string &start_id_in, const string &target_id_in, size_t k);
+    // every shortest path (the shortest path DAG), over the API or over the local graph, in one bfs; their
+    // number is kept in path_count() and the first max_paths of them are added to the graph
+    void  graph_by_path_dag(ClientPool& pool, const string &start_id_in, const string &target_id_in, size_t max_paths);
+    void  graph_by_local_path_dag(const GraphOverlay& local, httplib::SSLClient& cli, const string &start_id_in, const string &target_id_in, size_t max_paths);
+    // sizes the searches' maps for this many discovered works up front, so a large search never rehashes part way
+    // through; by default enough for max_size expanded works with a typical reference list each
+    void  set_expected_nodes(size_t n) { expected_nodes_ = n; }
     vector<Node> &nodes() { return nodes_; }
-    const vector<pair<size_t,size_t>> &directed_edges() const { return dir_;   }
+    const vector<pair<uint32_t,uint32_t>> &directed_edges() const { return dir_; }
+    // every path found, as node indices from start to target
+    const vector<vector<size_t>> &paths() const { return paths_; }
+    // number of shortest paths found by the last path dag search
+    const PathCount &path_count() const { return path_count_; }
     size_t get_size() { return nodes_.size(); }
 private:
+    friend class GraphBuilder;
+    void  add_path(httplib::SSLClient& cli, const FlatMap<WorkId,WorkId> &prev, WorkId start_id, WorkId target_id);
+    void  add_path(httplib::SSLClient& cli, const vector<WorkId> &id_path);
+    void  add_paths(httplib::SSLClient& cli, const vector<vector<WorkId>> &id_paths);
+    void  add_dag_paths(httplib::SSLClient& cli, const PathDag &dag, size_t max_paths);
     size_t                             max_depth = 10;
     size_t                             max_size = 500;
+    int                                max_hop_years = 20; // a* estimate of how far back one reference reaches
+    size_t                             expected_nodes_ = 0;
+    size_t expected_nodes() const { return expected_nodes_ ? expected_nodes_ : max_size * 64; }
     vector<Node>                       nodes_;
-    unordered_map<string,size_t>       idx_;
-    vector<pair<size_t,size_t>>        dir_;
+    FlatMap<WorkId,size_t>             idx_;
+    vector<pair<uint32_t,uint32_t>>    dir_;
+    vector<vector<size_t>>             paths_;
+    PathCount                          path_count_;
+    // CSR of dir_, built by finalize()
+    vector<uint32_t>                   out_offsets_ = {0};
+    vector<uint32_t>                   out_edges_;
+    vector<uint32_t>                   in_offsets_ = {0};
+    vector<uint32_t>                   in_edges_;
 };
 
 #endif
\ No newline at end of file
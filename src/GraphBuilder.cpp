@@ -0,0 +1,51 @@
+#include "GraphBuilder.h"
+
+GraphBuilder::GraphBuilder(const size_t shards)
+    : shard_count_(max<size_t>(shards, 1)), shards_(make_unique<Shard[]>(shard_count_)) {}
+
+uint32_t GraphBuilder::add_node(const WorkId id, const string& title) {
+    Shard& shard = shard_of(id);
+    lock_guard lock(shard.guard);
+    auto [it, added] = shard.idx.try_emplace(id, 0);
+    if (added) {
+        it->second = next_index_.fetch_add(1, memory_order_relaxed);
+        shard.nodes.emplace_back(it->second, Node(id, title));
+    }
+    return it->second;
+}
+
+void GraphBuilder::Writer::add_edge(const WorkId from_id, const WorkId to_id) {
+    edges_.push_back({builder_->add_node(from_id), builder_->add_node(to_id)});
+}
+
+void GraphBuilder::Writer::flush() {
+    if (edges_.empty()) return;
+    lock_guard lock(builder_->edges_mutex_);
+    builder_->edges_.push_back(move(edges_));
+    edges_.clear();
+}
+
+Graph GraphBuilder::finalize() {
+    Graph graph;
+    const uint32_t n = next_index_.load();
+
+    // place every shard's nodes at their index
+    vector<Node*> nodes(n);
+    for (size_t s = 0; s < shard_count_; ++s) {
+        for (auto& [i, node] : shards_[s].nodes) nodes[i] = &node;
+    }
+    graph.nodes_.reserve(n);
+    graph.idx_.reserve(n);
+    for (uint32_t i = 0; i < n; ++i) {
+        graph.idx_[nodes[i]->work_id()] = i;
+        graph.nodes_.push_back(move(*nodes[i]));
+    }
+
+    size_t edge_count = 0;
+    for (const auto& buffer : edges_) edge_count += buffer.size();
+    graph.dir_.reserve(edge_count);
+    for (const auto& buffer : edges_) graph.dir_.insert(graph.dir_.end(), buffer.begin(), buffer.end());
+
+    graph.finalize();
+    return graph;
+}
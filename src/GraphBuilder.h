@@ -0,0 +1,61 @@
+#ifndef GRAPHBUILDER_H
+#define GRAPHBUILDER_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include "Graph.h"
+
+using namespace std;
+
+// collects the nodes and edges of a Graph from many threads at once, e.g. fetch or parse workers
+// - the ID → index map is split into shards, each with its own lock, so threads adding different works
+//   rarely wait on each other; indices come from one atomic counter
+// - each thread appends edges to its own Writer, whose buffer is handed over once, when it is done
+// finalize() then lays everything out as a Graph; indices are in order of first add, which depends on scheduling
+class GraphBuilder {
+public:
+    explicit GraphBuilder(size_t shards = 64);
+    GraphBuilder(const GraphBuilder&) = delete;
+    GraphBuilder& operator=(const GraphBuilder&) = delete;
+
+    // index of the node of id, adding it with title if it is new; safe to call from any thread
+    uint32_t add_node(WorkId id, const string& title = "<title>");
+
+    // a thread's edge buffer; edges reach the builder when the writer is flushed or destroyed
+    class Writer {
+    public:
+        explicit Writer(GraphBuilder& builder) : builder_(&builder) {}
+        ~Writer() { flush(); }
+        Writer(Writer&& other) noexcept : builder_(other.builder_), edges_(move(other.edges_)) { other.edges_.clear(); }
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        uint32_t add_node(WorkId id, const string& title = "<title>") { return builder_->add_node(id, title); }
+        // records the directed edge from → to, adding either node if it is new
+        void add_edge(WorkId from_id, WorkId to_id);
+        void flush();
+    private:
+        GraphBuilder*                   builder_;
+        vector<pair<uint32_t,uint32_t>> edges_;
+    };
+    Writer writer() { return Writer(*this); }
+
+    // the graph of every node added and every edge flushed so far; call once all writers are done
+    Graph finalize();
+private:
+    struct alignas(64) Shard {
+        mutex                                   guard;
+        FlatMap<WorkId,uint32_t>                idx;
+        vector<pair<uint32_t,Node>>             nodes;   // (index, node) in order of adding
+    };
+    Shard& shard_of(WorkId id) { return shards_[hash<WorkId>{}(id) % shard_count_]; }
+
+    size_t                                      shard_count_;
+    unique_ptr<Shard[]>                         shards_;
+    atomic<uint32_t>                            next_index_ = 0;
+    mutex                                       edges_mutex_;
+    vector<vector<pair<uint32_t,uint32_t>>>     edges_;  // flushed writer buffers
+};
+
+#endif //GRAPHBUILDER_H
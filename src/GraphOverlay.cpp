@@ -0,0 +1,205 @@
+#include "GraphOverlay.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+// file layout, all integers little-endian
+//   "KPGD" u32 version u64 generation, then records:
+//   u64 id | i32 year | u32 n_refs | u64 refs[n_refs]
+// the generation changes whenever the log is started over, so a DeltaMark from an older log is never misread
+static const char     delta_magic[4] = {'K', 'P', 'G', 'D'};
+static const uint32_t delta_version  = 1;
+static const size_t   delta_header   = 16;
+static const size_t   record_header  = 16;
+
+template <typename T>
+static T get_raw(const char* p) {
+    T v;
+    memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+template <typename T>
+static void write_raw(ofstream& out, const T& v) {
+    out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+// generation of a mapped log, or 0 if it is not a valid one
+static uint64_t delta_generation(const MappedFile& log) {
+    if (!log.is_open() || log.size() < delta_header || memcmp(log.data(), delta_magic, 4) != 0
+        || get_raw<uint32_t>(log.data() + 4) != delta_version)
+        return 0;
+    return get_raw<uint64_t>(log.data() + 8);
+}
+
+// writes an empty log with a fresh generation, replacing whatever is at path
+static bool start_delta(const string& path) {
+    uint64_t generation = 0;
+    while (!generation) {
+        generation = (uint64_t(random_device{}()) << 32)
+                   ^ static_cast<uint64_t>(chrono::system_clock::now().time_since_epoch().count());
+    }
+    const string tmp_path = path + ".kpd.tmp";
+    {
+        ofstream out(tmp_path, ios::binary | ios::trunc);
+        out.write(delta_magic, 4);
+        write_raw(out, delta_version);
+        write_raw(out, generation);
+        if (!out) return false;
+    }
+    error_code ec;
+    filesystem::rename(tmp_path, path + ".kpd", ec);
+    return !ec;
+}
+
+bool append_delta(const string& path, span<const WorkRecord> works) {
+    if (!delta_generation(MappedFile(path + ".kpd")) && !start_delta(path)) return false;
+    ofstream out(path + ".kpd", ios::binary | ios::app);
+    for (const auto& rec : works) {
+        if (!rec.id || rec.id.is_interned()) continue;
+        write_raw(out, rec.id.value);
+        write_raw(out, rec.year);
+        write_raw(out, static_cast<uint32_t>(rec.refs.size()));
+        for (const WorkId ref : rec.refs) write_raw(out, ref.value);
+    }
+    return static_cast<bool>(out);
+}
+
+void reset_delta(const string& path, const DeltaMark applied) {
+    MappedFile log(path + ".kpd");
+    if (!log.is_open() || (delta_generation(log) == applied.generation && log.size() == applied.offset)) {
+        log.close();
+        start_delta(path);
+    }
+}
+
+vector<WorkRecord> read_delta(const string& path, DeltaMark& mark) {
+    vector<WorkRecord> records;
+    MappedFile log(path + ".kpd");
+    const uint64_t generation = delta_generation(log);
+    if (!generation) return records;
+    if (generation != mark.generation || mark.offset < delta_header) mark = {generation, delta_header};
+
+    uint64_t offset = mark.offset;
+    while (offset + record_header <= log.size()) {
+        const char* p = log.data() + offset;
+        const uint64_t length = record_header + get_raw<uint32_t>(p + 12) * 8ull;
+        if (offset + length > log.size()) break; // still being written
+        WorkRecord rec;
+        rec.id = WorkId(get_raw<uint64_t>(p));
+        rec.year = get_raw<int32_t>(p + 8);
+        rec.fields = WorkRecord::YEAR | WorkRecord::REFS;
+        rec.refs.resize(get_raw<uint32_t>(p + 12));
+        memcpy(rec.refs.data(), p + record_header, rec.refs.size() * 8);
+        records.push_back(move(rec));
+        offset += length;
+    }
+    mark.offset = offset;
+    return records;
+}
+
+GraphOverlay::GraphOverlay(shared_ptr<const LocalGraph> base, vector<WorkRecord> delta, const DeltaMark mark)
+    : base_(move(base)), delta_(move(delta)), mark_(mark) {
+    // the latest record of each work
+    unordered_map<uint64_t, const WorkRecord*> latest;
+    for (const auto& rec : delta_) {
+        if (rec.id && !rec.id.is_interned()) latest[rec.id.value] = &rec;
+    }
+    for (const auto& [id, rec] : latest) {
+        if (base_->find(WorkId(id)) == npos) new_ids_.push_back(id);
+    }
+    sort(new_ids_.begin(), new_ids_.end());
+
+    // references; ones to works in neither the graph nor the delta are dropped, as in LocalGraph::build
+    for (const auto& [id, rec] : latest) {
+        const uint32_t u = find(WorkId(id));
+        years_[u] = rec->year;
+        vector<uint32_t>& refs = out_[u];
+        for (const WorkId ref : rec->refs) {
+            const uint32_t v = find(ref);
+            if (v != npos) refs.push_back(v);
+        }
+        sort(refs.begin(), refs.end());
+        refs.erase(unique(refs.begin(), refs.end()), refs.end());
+    }
+
+    // citations the base graph does not have; the ones it has but no longer holds are filtered out in in_edges,
+    // and only counted here
+    vector<uint32_t> buffer;
+    edge_count_ = base_->edge_count();
+    for (const auto& [u, refs] : out_) {
+        const span<const uint32_t> base_refs = u < base_->node_count() ? base_->out_edges(u, buffer) : span<const uint32_t>();
+        for (const uint32_t v : refs) {
+            if (!binary_search(base_refs.begin(), base_refs.end(), v)) in_added_[v].push_back(u);
+        }
+        for (const uint32_t v : base_refs) {
+            if (!binary_search(refs.begin(), refs.end(), v)) in_removed_[v]++;
+        }
+        edge_count_ += refs.size();
+        edge_count_ -= base_refs.size();
+    }
+    for (auto& [v, citers] : in_added_) {
+        sort(citers.begin(), citers.end());
+    }
+}
+
+uint32_t GraphOverlay::find(const WorkId id) const {
+    const uint32_t v = base_->find(id);
+    if (v != npos) return v;
+    auto it = lower_bound(new_ids_.begin(), new_ids_.end(), id.value);
+    if (it == new_ids_.end() || *it != id.value) return npos;
+    return base_->node_count() + static_cast<uint32_t>(it - new_ids_.begin());
+}
+
+WorkId GraphOverlay::id(const uint32_t v) const {
+    return v < base_->node_count() ? base_->id(v) : WorkId(new_ids_[v - base_->node_count()]);
+}
+
+int32_t GraphOverlay::year(const uint32_t v) const {
+    auto it = years_.find(v);
+    if (it != years_.end()) return it->second;
+    return v < base_->node_count() ? base_->year(v) : 0;
+}
+
+span<const uint32_t> GraphOverlay::out_edges(const uint32_t v, vector<uint32_t>& buffer) const {
+    auto it = out_.find(v);
+    if (it != out_.end()) return it->second;
+    return v < base_->node_count() ? base_->out_edges(v, buffer) : span<const uint32_t>();
+}
+
+span<const uint32_t> GraphOverlay::in_edges(const uint32_t v, vector<uint32_t>& buffer) const {
+    if (out_.empty()) return v < base_->node_count() ? base_->in_edges(v, buffer) : span<const uint32_t>();
+
+    thread_local vector<uint32_t> base_buffer;
+    const span<const uint32_t> base_in = v < base_->node_count() ? base_->in_edges(v, base_buffer) : span<const uint32_t>();
+    buffer.clear();
+    for (const uint32_t u : base_in) {
+        // a changed work may no longer cite v
+        auto it = out_.find(u);
+        if (it == out_.end() || binary_search(it->second.begin(), it->second.end(), v)) buffer.push_back(u);
+    }
+    auto added = in_added_.find(v);
+    if (added != in_added_.end()) {
+        const size_t middle = buffer.size();
+        buffer.insert(buffer.end(), added->second.begin(), added->second.end());
+        inplace_merge(buffer.begin(), buffer.begin() + middle, buffer.end());
+    }
+    return buffer;
+}
+
+uint64_t GraphOverlay::out_degree(const uint32_t v) const {
+    auto it = out_.find(v);
+    if (it != out_.end()) return it->second.size();
+    return v < base_->node_count() ? base_->out_degree(v) : 0;
+}
+
+uint64_t GraphOverlay::in_degree(const uint32_t v) const {
+    auto added = in_added_.find(v);
+    auto removed = in_removed_.find(v);
+    return (v < base_->node_count() ? base_->in_degree(v) : 0) + (added != in_added_.end() ? added->second.size() : 0)
+           - (removed != in_removed_.end() ? removed->second : 0);
+}
+
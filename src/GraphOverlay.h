@@ -0,0 +1,66 @@
+#ifndef GRAPHOVERLAY_H
+#define GRAPHOVERLAY_H
+
+#include <memory>
+#include <unordered_map>
+#include "LocalGraph.h"
+
+using namespace std;
+
+// works changed since the local graph was built are appended to the delta log <path>.kpd by Ingest --update
+// and laid over the graph instead of rebuilding it; LiveGraph folds them in once there are enough
+// the log has a single writer (Ingest); readers only ever read up to the last complete record
+
+// appends the year and references of works to the delta log, creating it if needed; false if it cannot be written
+bool append_delta(const string& path, span<const WorkRecord> works);
+
+// starts a new, empty delta log if applied (a graph's delta_mark()) covers all of the current one
+void reset_delta(const string& path, DeltaMark applied);
+
+// the records of the delta log after mark (all of them if mark is from another generation of the log)
+// mark is moved to the end of what was read
+vector<WorkRecord> read_delta(const string& path, DeltaMark& mark);
+
+// immutable view of a local graph with delta records laid over it
+// works in the delta replace their node's year and references (and so the citations they add or remove);
+// works new to the graph get nodes numbered after the base graph's
+// it has the accessors of LocalGraph, so searches run on it the same way
+class GraphOverlay {
+public:
+    static constexpr uint32_t npos = LocalGraph::npos;
+
+    // delta: records in log order (later ones win); mark: the end of the log they were read up to
+    GraphOverlay(shared_ptr<const LocalGraph> base, vector<WorkRecord> delta, DeltaMark mark);
+
+    const LocalGraph& base()       const { return *base_; }
+    const shared_ptr<const LocalGraph>& shared_base() const { return base_; }
+    const vector<WorkRecord>& delta() const { return delta_; }
+    DeltaMark         mark()       const { return mark_; }
+    // number of works the overlay changes or adds
+    size_t            overlaid()   const { return out_.size(); }
+    uint32_t          node_count() const { return base_->node_count() + static_cast<uint32_t>(new_ids_.size()); }
+    // references of all works, with the delta's in place of the ones it changes
+    uint64_t          edge_count() const { return edge_count_; }
+
+    uint32_t find(WorkId id) const;
+    WorkId   id(uint32_t v)   const;
+    int32_t  year(uint32_t v) const;
+    // as LocalGraph::out_edges and in_edges
+    span<const uint32_t> out_edges(uint32_t v, vector<uint32_t>& buffer) const;
+    span<const uint32_t> in_edges(uint32_t v, vector<uint32_t>& buffer) const;
+    // lengths of those lists without building them
+    uint64_t out_degree(uint32_t v) const;
+    uint64_t in_degree(uint32_t v)  const;
+private:
+    shared_ptr<const LocalGraph>                base_;
+    vector<WorkRecord>                          delta_;
+    DeltaMark                                   mark_;
+    vector<uint64_t>                            new_ids_;   // ascending; node base_->node_count() + i
+    unordered_map<uint32_t, int32_t>            years_;     // of every overlaid node
+    unordered_map<uint32_t, vector<uint32_t>>   out_;       // references of every overlaid node, sorted
+    unordered_map<uint32_t, vector<uint32_t>>   in_added_;  // citations not in the base graph, sorted
+    unordered_map<uint32_t, uint64_t>           in_removed_; // number of the base graph's citations the delta drops
+    uint64_t                                    edge_count_ = 0;
+};
+
+#endif //GRAPHOVERLAY_H
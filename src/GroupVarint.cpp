@@ -0,0 +1,117 @@
+#include "GroupVarint.h"
+#include <array>
+#include <cstring>
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <tmmintrin.h>
+#define GROUP_VARINT_SSSE3
+#endif
+
+static unsigned byte_length(const uint32_t v) {
+    return v < (1u << 8) ? 1 : v < (1u << 16) ? 2 : v < (1u << 24) ? 3 : 4;
+}
+
+void group_varint_encode(span<const uint32_t> sorted, string& out) {
+    // length
+    for (uint64_t n = sorted.size(); ; n >>= 7) {
+        if (n < 0x80) {
+            out.push_back(static_cast<char>(n));
+            break;
+        }
+        out.push_back(static_cast<char>((n & 0x7F) | 0x80));
+    }
+
+    // gaps, four at a time; the last group is filled up with zero gaps
+    uint32_t prev = 0;
+    for (size_t i = 0; i < sorted.size(); i += 4) {
+        uint32_t gaps[4] = {};
+        for (size_t k = 0; k < 4 && i + k < sorted.size(); k++) {
+            gaps[k] = sorted[i + k] - prev;
+            prev = sorted[i + k];
+        }
+        uint8_t control = 0;
+        for (int k = 0; k < 4; k++) {
+            control |= static_cast<uint8_t>((byte_length(gaps[k]) - 1) << (2 * k));
+        }
+        out.push_back(static_cast<char>(control));
+        for (int k = 0; k < 4; k++) {
+            const unsigned len = byte_length(gaps[k]);
+            for (unsigned b = 0; b < len; b++) {
+                out.push_back(static_cast<char>(gaps[k] >> (8 * b)));
+            }
+        }
+    }
+}
+
+// for each control byte: the total length of its four gaps, and (for the vector path) the shuffle that
+// spreads their bytes into four little-endian u32 lanes, 0x80 zeroing the unused high bytes
+struct GroupTable {
+    array<uint8_t, 256>             length;
+    array<array<uint8_t, 16>, 256>  shuffle;
+    constexpr GroupTable() : length(), shuffle() {
+        for (unsigned control = 0; control < 256; control++) {
+            uint8_t src = 0;
+            for (unsigned k = 0; k < 4; k++) {
+                const unsigned len = ((control >> (2 * k)) & 3) + 1;
+                for (unsigned b = 0; b < 4; b++) {
+                    shuffle[control][4 * k + b] = b < len ? src++ : 0x80;
+                }
+            }
+            length[control] = src;
+        }
+    }
+};
+static constexpr GroupTable group_table;
+
+// reads the LEB128 list length at in, moving in past it
+static uint64_t read_length(const uint8_t*& in) {
+    uint64_t n = 0;
+    for (unsigned shift = 0; ; shift += 7) {
+        const uint8_t byte = *in++;
+        n |= uint64_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return n;
+    }
+}
+
+uint64_t group_varint_length(const uint8_t* in) {
+    return read_length(in);
+}
+
+const uint8_t* group_varint_decode(const uint8_t* in, vector<uint32_t>& out) {
+    const uint64_t n = read_length(in);
+    // room for the zero gaps of the last group
+    out.resize((n + 3) & ~uint64_t(3));
+    uint32_t* dst = out.data();
+    uint32_t* end = dst + out.size();
+
+#ifdef GROUP_VARINT_SSSE3
+    __m128i prev = _mm_setzero_si128();
+    for (; dst != end; dst += 4) {
+        const uint8_t control = *in++;
+        const __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group_table.shuffle[control].data()));
+        __m128i gaps = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)), shuffle);
+        in += group_table.length[control];
+        // inclusive prefix sum of the four gaps, on top of the last value of the previous group
+        gaps = _mm_add_epi32(gaps, _mm_slli_si128(gaps, 4));
+        gaps = _mm_add_epi32(gaps, _mm_slli_si128(gaps, 8));
+        const __m128i values = _mm_add_epi32(gaps, prev);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), values);
+        prev = _mm_shuffle_epi32(values, 0xFF);
+    }
+#else
+    uint32_t prev = 0;
+    for (; dst != end; dst += 4) {
+        const uint8_t control = *in++;
+        for (unsigned k = 0; k < 4; k++) {
+            const unsigned len = ((control >> (2 * k)) & 3) + 1;
+            uint32_t gap = 0;
+            memcpy(&gap, in, len); // little-endian
+            in += len;
+            prev += gap;
+            dst[k] = prev;
+        }
+    }
+#endif
+    out.resize(n);
+    return in;
+}
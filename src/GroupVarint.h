@@ -0,0 +1,29 @@
+#ifndef GROUPVARINT_H
+#define GROUPVARINT_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// compressed form of a sorted list of node indices, as used for the local graph's edge lists
+// the list is stored as its length (LEB128 varint), then the gaps between consecutive values (the first one
+// from 0) in groups of four: a control byte holding each gap's byte length - 1 in two bits, then the gaps'
+// low bytes, so a gap costs 1 to 4 bytes plus a quarter byte
+// on x86 with SSSE3 a whole group is decoded with one byte shuffle and a vector prefix sum
+
+// bytes the decoder may read past the end of the last list; streams must be followed by this much padding
+static constexpr size_t group_varint_padding = 16;
+
+// appends the encoding of sorted to out
+void group_varint_encode(span<const uint32_t> sorted, string& out);
+
+// decodes the list starting at in into out (replacing its contents); returns the end of the list
+const uint8_t* group_varint_decode(const uint8_t* in, vector<uint32_t>& out);
+
+// number of values in the list starting at in, read from its header without decoding the list
+uint64_t group_varint_length(const uint8_t* in);
+
+#endif //GROUPVARINT_H
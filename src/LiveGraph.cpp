@@ -0,0 +1,125 @@
+#include "LiveGraph.h"
+#include <algorithm>
+#include <iostream>
+
+LiveGraph::LiveGraph(const string& path, const size_t compact_threshold, const size_t threads)
+    : path_(path), compact_threshold_(compact_threshold), threads_(threads) {
+    reload();
+    refresh();
+}
+
+LiveGraph::~LiveGraph() {
+    wait();
+}
+
+shared_ptr<const GraphOverlay> LiveGraph::snapshot() const {
+    lock_guard<mutex> lock(mutex_);
+    return current_;
+}
+
+// the newest generation of the graph; the files of older ones are removed when it goes, if a newer one has been
+// written by then, so a superseded file stays for exactly as long as snapshots still search it
+shared_ptr<const LocalGraph> LiveGraph::open_base() const {
+    return shared_ptr<const LocalGraph>(new LocalGraph(path_), [path = path_](const LocalGraph* graph) {
+        const uint64_t generation = graph->generation();
+        delete graph;
+        if (const uint64_t latest = LocalGraph::latest_generation(path); generation < latest)
+            LocalGraph::remove_generations(path, latest);
+    });
+}
+
+// maps the graph file again and lays the part of the delta log it does not contain over it
+void LiveGraph::reload() {
+    auto base = open_base();
+    DeltaMark mark = base->delta_mark();
+    vector<WorkRecord> delta = read_delta(path_, mark);
+    auto overlay = make_shared<const GraphOverlay>(move(base), move(delta), mark);
+    lock_guard<mutex> lock(mutex_);
+    current_ = move(overlay);
+}
+
+void LiveGraph::refresh() {
+    shared_ptr<const GraphOverlay> current = snapshot();
+    DeltaMark mark = current->mark();
+    vector<WorkRecord> added = read_delta(path_, mark);
+    if (!compacting_ && LocalGraph::latest_generation(path_) > current->base().generation()) {
+        // Ingest rebuilt the graph, and removed the log with the older graphs; a compaction swaps in its own
+        reload();
+    } else if (current->mark().generation && mark.generation != current->mark().generation) {
+        // the log was started over, which Ingest only does once a graph file holds all of it
+        reload();
+    } else if (!added.empty()) {
+        vector<WorkRecord> delta = current->delta();
+        delta.insert(delta.end(), make_move_iterator(added.begin()), make_move_iterator(added.end()));
+        auto overlay = make_shared<const GraphOverlay>(current->shared_base(), move(delta), mark);
+        lock_guard<mutex> lock(mutex_);
+        // a compaction may have swapped in a newer graph meanwhile; it read the log to its end itself
+        if (current_ == current) current_ = move(overlay);
+    }
+
+    // failed_at_ is only written by a compaction before it clears compacting_
+    current = snapshot();
+    if (compacting_ || current->overlaid() < compact_threshold_) return;
+    if (current->mark().generation == failed_at_.generation && current->mark().offset <= failed_at_.offset) return;
+    if (compactor_.joinable()) compactor_.join();
+    compacting_ = true;
+    compactor_ = thread(&LiveGraph::compact, this, current);
+}
+
+void LiveGraph::wait() {
+    if (compactor_.joinable()) compactor_.join();
+}
+
+void LiveGraph::compact(shared_ptr<const GraphOverlay> from) {
+    cout << "Compacting " << from->overlaid() << " changed works into the local graph" << endl;
+    auto base = write_compacted(path_, *from, threads_) ? open_base() : nullptr;
+    if (!base || !base->is_open()) {
+        cout << "Compaction failed; searching the overlay meanwhile" << endl;
+        failed_at_ = from->mark();
+        compacting_ = false;
+        return;
+    }
+    // the new graph holds the log up to from's mark; whatever was appended since goes on top of it
+    DeltaMark mark = base->delta_mark();
+    vector<WorkRecord> rest = read_delta(path_, mark);
+    auto overlay = make_shared<const GraphOverlay>(move(base), move(rest), mark);
+    {
+        lock_guard<mutex> lock(mutex_);
+        current_ = move(overlay);
+    }
+    compacting_ = false;
+}
+
+bool write_compacted(const string& path, const GraphOverlay& overlay, const size_t threads) {
+    // new nodes are numbered after the base graph's (which may not be in id order); interleave them in id order
+    const LocalGraph& base = overlay.base();
+    const uint32_t base_nodes = base.node_count();
+    const uint32_t nodes = overlay.node_count();
+    vector<uint32_t> order;  // old node of each new one
+    vector<uint32_t> remap(nodes);
+    order.reserve(nodes);
+    for (uint32_t i = 0, j = base_nodes; i < base_nodes || j < nodes;) {
+        const bool take_base = j == nodes || (i < base_nodes && overlay.id(base.by_id(i)) < overlay.id(j));
+        const uint32_t old = take_base ? base.by_id(i++) : j++;
+        remap[old] = static_cast<uint32_t>(order.size());
+        order.push_back(old);
+    }
+
+    vector<uint64_t> ids(nodes);
+    vector<int16_t> years(nodes);
+    vector<uint64_t> out_offsets(nodes + 1, 0);
+    vector<uint32_t> buffer;
+    for (uint32_t v = 0; v < nodes; v++) {
+        ids[v] = overlay.id(order[v]).value;
+        years[v] = static_cast<int16_t>(clamp(overlay.year(order[v]), int32_t(INT16_MIN), int32_t(INT16_MAX)));
+        out_offsets[v + 1] = out_offsets[v] + overlay.out_edges(order[v], buffer).size();
+    }
+    vector<uint32_t> out_edges(out_offsets[nodes]);
+    for (uint32_t v = 0; v < nodes; v++) {
+        auto list = out_edges.begin() + out_offsets[v];
+        for (const uint32_t old : overlay.out_edges(order[v], buffer)) *list++ = remap[old];
+        // new nodes can land anywhere among the old ones
+        sort(out_edges.begin() + out_offsets[v], list);
+    }
+    return LocalGraph::write(path, ids, years, out_offsets, out_edges, overlay.base().compressed(), threads, overlay.mark());
+}
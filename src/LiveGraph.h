@@ -0,0 +1,52 @@
+#ifndef LIVEGRAPH_H
+#define LIVEGRAPH_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "GraphOverlay.h"
+
+using namespace std;
+
+// the local graph <path>.kpg with the delta log <path>.kpd laid over it, kept current while searches run
+// searches take a snapshot() and keep using it for as long as they like; refresh() and compaction only ever
+// swap in a new snapshot, so no search waits on either
+// once the overlay holds compact_threshold works, a background thread writes a new .kpg with them folded in, as the
+// graph's next generation; the file of the one before is removed once no snapshot uses it any more
+class LiveGraph {
+public:
+    LiveGraph(const string& path, size_t compact_threshold, size_t threads = 1);
+    ~LiveGraph();
+    LiveGraph(const LiveGraph&) = delete;
+    LiveGraph& operator=(const LiveGraph&) = delete;
+
+    // the graph as of the last refresh or compaction
+    shared_ptr<const GraphOverlay> snapshot() const;
+    // lays over works appended to the delta log since the last call, or switches to a graph Ingest has rebuilt
+    // meanwhile, and starts compacting if there are enough
+    void refresh();
+    // true while a compaction is running
+    bool compacting() const { return compacting_; }
+    // waits for a running compaction to finish
+    // refresh() and wait() are meant to be called from one thread, e.g. the GUI's
+    void wait();
+private:
+    void reload();
+    shared_ptr<const LocalGraph> open_base() const;
+    void compact(shared_ptr<const GraphOverlay> from);
+
+    string                          path_;
+    size_t                          compact_threshold_;
+    size_t                          threads_;
+    mutable mutex                   mutex_;
+    shared_ptr<const GraphOverlay>  current_;
+    thread                          compactor_;
+    atomic<bool>                    compacting_ = false;
+    DeltaMark                       failed_at_; // not retried until the delta grows past this
+};
+
+// writes the graph of overlay, base and delta together, as the next generation of the graph at path, marked as containing the delta up to overlay.mark()
+// the edge encoding follows the base graph's; returns false if the file could not be written
+bool write_compacted(const string& path, const GraphOverlay& overlay, size_t threads = 1);
+
+#endif //LIVEGRAPH_H
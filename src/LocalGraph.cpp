@@ -0,0 +1,444 @@
+#include "LocalGraph.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+// file layout, all integers little-endian
+//   header:   "KPGR" u32 version u64 node_count u64 edge_count u32 section_count u32 reserved
+//   sections: section_count × (u32 kind, u32 reserved, u64 offset, u64 length), then the sections themselves,
+//             each starting on an 8-byte boundary:
+//     IDS         u64[node_count]      work ID of each node; ascending unless there is an ID_INDEX
+//     YEARS       i16[node_count]      publication years, 0 if unknown
+//     OUT_OFFSETS u64[node_count + 1]  node v's references are OUT_EDGES[OUT_OFFSETS[v] .. OUT_OFFSETS[v + 1])
+//     OUT_EDGES   u32[edge_count]
+//     IN_OFFSETS  u64[node_count + 1]  the same for citations
+//     IN_EDGES    u32[edge_count]
+// or, in compressed files, in place of OUT_EDGES and IN_EDGES:
+//     OUT_EDGES_GV  group varint lists (see GroupVarint.h), one per node, followed by group_varint_padding zero bytes;
+//                   OUT_OFFSETS then holds byte offsets into it
+//     IN_EDGES_GV   the same for citations
+// and optionally:
+//     DELTA_MARK  u64 generation u64 offset  how much of the delta log (see GraphOverlay.h) is already in the graph
+//     ID_INDEX    u32[node_count]      the nodes in ascending order of their IDs, for graphs whose nodes are
+//                                      numbered otherwise (compressed ones, see locality_order)
+// sections of unknown kinds are skipped, so later versions can add some without breaking readers
+static const char     graph_magic[4] = {'K', 'P', 'G', 'R'};
+static const uint32_t graph_version  = 2;
+// version 1 files are read too: they are version 2 files that never have an ID_INDEX
+static const uint32_t oldest_graph_version = 1;
+static const size_t   graph_header   = 32;
+static const size_t   section_entry  = 24;
+
+enum Section : uint32_t {
+    IDS = 1,
+    YEARS,
+    OUT_OFFSETS,
+    OUT_EDGES,
+    IN_OFFSETS,
+    IN_EDGES,
+    OUT_EDGES_GV,
+    IN_EDGES_GV,
+    DELTA_MARK,
+    ID_INDEX
+};
+
+template <typename T>
+static T get_raw(const char* p) {
+    T v;
+    memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+template <typename T>
+static void write_raw(ofstream& out, const T& v) {
+    out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+// the generations of the graph at path that have a file, in no particular order
+static vector<uint64_t> generations(const string& path) {
+    vector<uint64_t> found;
+    if (filesystem::exists(path + ".kpg")) found.push_back(0);
+    const filesystem::path dir = filesystem::path(path).parent_path();
+    const string prefix = filesystem::path(path).filename().string() + ".";
+    error_code ec;
+    for (const auto& entry : filesystem::directory_iterator(dir.empty() ? filesystem::path(".") : dir, ec)) {
+        // <prefix><digits>.kpg; half-written .kpg.tmp files do not count
+        const string name = entry.path().filename().string();
+        if (!name.starts_with(prefix) || !name.ends_with(".kpg")) continue;
+        const string digits = name.substr(prefix.size(), name.size() - prefix.size() - 4);
+        if (digits.empty() || digits.size() > 19 || digits.find_first_not_of("0123456789") != string::npos) continue;
+        found.push_back(stoull(digits));
+    }
+    return found;
+}
+
+string LocalGraph::file_name(const string& path, const uint64_t generation) {
+    return generation ? path + "." + to_string(generation) + ".kpg" : path + ".kpg";
+}
+
+uint64_t LocalGraph::latest_generation(const string& path) {
+    const vector<uint64_t> found = generations(path);
+    return found.empty() ? 0 : *max_element(found.begin(), found.end());
+}
+
+void LocalGraph::remove_generations(const string& path, const uint64_t generation) {
+    for (const uint64_t older : generations(path)) {
+        error_code ec;
+        if (older < generation) filesystem::remove(file_name(path, older), ec);
+    }
+}
+
+LocalGraph::LocalGraph(const string& path)
+    : generation_(latest_generation(path)), file_(file_name(path, generation_)) {
+    const char* base = file_.data();
+    const size_t size = file_.size();
+    if (!file_.is_open() || size < graph_header || memcmp(base, graph_magic, 4) != 0
+        || get_raw<uint32_t>(base + 4) < oldest_graph_version || get_raw<uint32_t>(base + 4) > graph_version)
+        return;
+    const uint64_t nodes = get_raw<uint64_t>(base + 8);
+    const uint64_t edges = get_raw<uint64_t>(base + 16);
+    const uint32_t sections = get_raw<uint32_t>(base + 24);
+    if (nodes >= npos || graph_header + uint64_t(sections) * section_entry > size) return;
+
+    // every section has to be in bounds, and the fixed-size ones exactly as long as the counts say
+    const void* found[ID_INDEX + 1] = {};
+    uint64_t lengths[ID_INDEX + 1] = {};
+    const uint64_t expected[IN_EDGES + 1] = {0, nodes * 8, nodes * 2, (nodes + 1) * 8, edges * 4, (nodes + 1) * 8, edges * 4};
+    for (uint32_t s = 0; s < sections; s++) {
+        const char* entry = base + graph_header + s * section_entry;
+        const uint32_t kind = get_raw<uint32_t>(entry);
+        const uint64_t offset = get_raw<uint64_t>(entry + 8);
+        const uint64_t length = get_raw<uint64_t>(entry + 16);
+        if (kind < IDS || kind > ID_INDEX) continue;
+        if (offset % 8 != 0 || offset > size || length > size - offset) return;
+        if (kind <= IN_EDGES && length != expected[kind]) return;
+        if (kind == DELTA_MARK && length != 16) return;
+        if (kind == ID_INDEX && length != nodes * 4) return;
+        found[kind] = base + offset;
+        lengths[kind] = length;
+    }
+    const bool compressed = found[OUT_EDGES_GV] && found[IN_EDGES_GV];
+    if (!found[IDS] || !found[YEARS] || !found[OUT_OFFSETS] || !found[IN_OFFSETS]
+        || (!compressed && (!found[OUT_EDGES] || !found[IN_EDGES])))
+        return;
+
+    ids_ = static_cast<const uint64_t*>(found[IDS]);
+    years_ = static_cast<const int16_t*>(found[YEARS]);
+    id_index_ = static_cast<const uint32_t*>(found[ID_INDEX]);
+    out_offsets_ = static_cast<const uint64_t*>(found[OUT_OFFSETS]);
+    in_offsets_ = static_cast<const uint64_t*>(found[IN_OFFSETS]);
+    if (compressed) {
+        out_bytes_ = reinterpret_cast<const uint8_t*>(found[OUT_EDGES_GV]);
+        in_bytes_ = reinterpret_cast<const uint8_t*>(found[IN_EDGES_GV]);
+        // the lists have to end with the decoder's padding still inside the section
+        if (lengths[OUT_EDGES_GV] < group_varint_padding || out_offsets_[nodes] != lengths[OUT_EDGES_GV] - group_varint_padding
+            || lengths[IN_EDGES_GV] < group_varint_padding || in_offsets_[nodes] != lengths[IN_EDGES_GV] - group_varint_padding)
+            return;
+    } else {
+        out_edges_ = static_cast<const uint32_t*>(found[OUT_EDGES]);
+        in_edges_ = static_cast<const uint32_t*>(found[IN_EDGES]);
+        // a torn offset table would send edge spans out of the mapping
+        if (out_offsets_[nodes] != edges || in_offsets_[nodes] != edges) return;
+    }
+    if (found[DELTA_MARK]) {
+        delta_mark_ = {get_raw<uint64_t>(static_cast<const char*>(found[DELTA_MARK])),
+                       get_raw<uint64_t>(static_cast<const char*>(found[DELTA_MARK]) + 8)};
+    }
+    node_count_ = static_cast<uint32_t>(nodes);
+    edge_count_ = edges;
+}
+
+uint32_t LocalGraph::find(const WorkId id) const {
+    if (!id_index_) {
+        const uint64_t* end = ids_ + node_count_;
+        const uint64_t* it = lower_bound(ids_, end, id.value);
+        return (it != end && *it == id.value) ? static_cast<uint32_t>(it - ids_) : npos;
+    }
+    // a torn index could point outside the ID array; such entries are skipped as not found
+    const uint32_t* end = id_index_ + node_count_;
+    const uint32_t* it = lower_bound(id_index_, end, id.value, [&](const uint32_t v, const uint64_t value) {
+        return v < node_count_ && ids_[v] < value;
+    });
+    return (it != end && *it < node_count_ && ids_[*it] == id.value) ? *it : npos;
+}
+
+// runs body(t, begin, end) for each of threads contiguous slices [begin, end) of [0, n) at once
+static void parallel_ranges(const size_t n, const size_t threads, const function<void(size_t, size_t, size_t)>& body) {
+    const size_t width = max<size_t>(1, min(threads, n));
+    vector<thread> workers;
+    for (size_t t = 1; t < width; t++) {
+        workers.emplace_back(body, t, n * t / width, n * (t + 1) / width);
+    }
+    body(0, 0, n / width);
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+
+// writes the group varint encoding of the lists of offsets/edges to out, followed by group_varint_padding zero bytes,
+// with byte_offsets set to each list's offset in it
+// each thread encodes a slice of the nodes into its own buffer; the buffers are then written in turn, so the
+// encoding never exists as one string
+static void write_compressed(ofstream& out, const vector<uint64_t>& offsets, const vector<uint32_t>& edges,
+                             vector<uint64_t>& byte_offsets, const size_t threads) {
+    const size_t nodes = offsets.size() - 1;
+    const size_t width = max<size_t>(1, min(threads, nodes));
+    byte_offsets.assign(nodes + 1, 0);
+    vector<string> parts(width);
+    parallel_ranges(nodes, width, [&](const size_t t, const size_t begin, const size_t end) {
+        string& bytes = parts[t];
+        for (size_t v = begin; v < end; v++) {
+            const span<const uint32_t> list(edges.data() + offsets[v], edges.data() + offsets[v + 1]);
+            byte_offsets[v] = bytes.size(); // relative to the slice until it is written
+            group_varint_encode(list, bytes);
+        }
+    });
+
+    uint64_t written = 0;
+    for (size_t t = 0; t < width; t++) {
+        for (size_t v = nodes * t / width; v < nodes * (t + 1) / width; v++) {
+            byte_offsets[v] += written;
+        }
+        out.write(parts[t].data(), static_cast<streamsize>(parts[t].size()));
+        written += parts[t].size();
+        parts[t] = string();
+    }
+    byte_offsets.back() = written;
+    static const char padding[group_varint_padding] = {};
+    out.write(padding, group_varint_padding);
+}
+
+// citations: the edges of out_offsets/out_edges counting-sorted by target into in_offsets/in_edges, then each list
+// sorted, as the encoding needs
+static void reverse_edges(const vector<uint64_t>& out_offsets, const vector<uint32_t>& out_edges,
+                          vector<uint64_t>& in_offsets, vector<uint32_t>& in_edges, const size_t threads) {
+    const size_t nodes = out_offsets.size() - 1;
+    in_offsets.assign(nodes + 1, 0);
+    parallel_ranges(nodes, threads, [&](size_t, const size_t begin, const size_t end) {
+        for (uint64_t e = out_offsets[begin]; e < out_offsets[end]; e++) {
+            atomic_ref<uint64_t>(in_offsets[out_edges[e] + 1]).fetch_add(1, memory_order_relaxed);
+        }
+    });
+    for (size_t v = 0; v < nodes; v++) in_offsets[v + 1] += in_offsets[v];
+    in_edges.assign(out_edges.size(), 0);
+    {
+        vector<uint64_t> fill(in_offsets.begin(), in_offsets.end() - 1);
+        parallel_ranges(nodes, threads, [&](size_t, const size_t begin, const size_t end) {
+            for (size_t u = begin; u < end; u++) {
+                for (uint64_t e = out_offsets[u]; e < out_offsets[u + 1]; e++) {
+                    in_edges[atomic_ref<uint64_t>(fill[out_edges[e]]).fetch_add(1, memory_order_relaxed)] = static_cast<uint32_t>(u);
+                }
+            }
+        });
+    }
+    parallel_ranges(nodes, threads, [&](size_t, const size_t begin, const size_t end) {
+        for (size_t v = begin; v < end; v++) {
+            sort(in_edges.begin() + in_offsets[v], in_edges.begin() + in_offsets[v + 1]);
+        }
+    });
+}
+
+// node numbering that keeps neighbours close, as old node of each new one: breadth-first order over references
+// and citations together, each node not reached yet (in ID order) starting the next search
+// a work's references and its citers are then mostly numbered one after another, so most gaps in both lists fit
+// in a byte, where in ID order they span the whole graph
+static vector<uint32_t> locality_order(const vector<uint64_t>& out_offsets, const vector<uint32_t>& out_edges,
+                                       const vector<uint64_t>& in_offsets, const vector<uint32_t>& in_edges) {
+    const size_t nodes = out_offsets.size() - 1;
+    vector<uint32_t> order;
+    order.reserve(nodes);
+    vector<bool> seen(nodes);
+    auto visit = [&](const uint32_t v) {
+        if (seen[v]) return;
+        seen[v] = true;
+        order.push_back(v);
+    };
+    // order doubles as the queue
+    for (uint32_t seed = 0; seed < nodes; seed++) {
+        size_t head = order.size();
+        visit(seed);
+        for (; head < order.size(); head++) {
+            const uint32_t u = order[head];
+            for (uint64_t e = out_offsets[u]; e < out_offsets[u + 1]; e++) visit(out_edges[e]);
+            for (uint64_t e = in_offsets[u]; e < in_offsets[u + 1]; e++) visit(in_edges[e]);
+        }
+    }
+    return order;
+}
+
+// the lists of offsets/edges moved to the new numbering, given as the old node of each new one (order) and the
+// new node of each old one (rank), each list sorted again
+static void renumber_edges(vector<uint64_t>& offsets, vector<uint32_t>& edges, const vector<uint32_t>& order,
+                           const vector<uint32_t>& rank, const size_t threads) {
+    const size_t nodes = order.size();
+    vector<uint64_t> new_offsets(nodes + 1, 0);
+    for (size_t v = 0; v < nodes; v++) {
+        new_offsets[v + 1] = new_offsets[v] + offsets[order[v] + 1] - offsets[order[v]];
+    }
+    vector<uint32_t> new_edges(edges.size());
+    parallel_ranges(nodes, threads, [&](size_t, const size_t begin, const size_t end) {
+        for (size_t v = begin; v < end; v++) {
+            auto list = new_edges.begin() + new_offsets[v];
+            for (uint64_t e = offsets[order[v]]; e < offsets[order[v] + 1]; e++) *list++ = rank[edges[e]];
+            sort(new_edges.begin() + new_offsets[v], list);
+        }
+    });
+    offsets.swap(new_offsets);
+    edges.swap(new_edges);
+}
+
+bool LocalGraph::build(const string& path, WorkCache& cache, const bool compress, const size_t threads) {
+    // nodes: the cache is visited in id order, so node v is the v-th cached work
+    cache.flush();
+    const size_t count = cache.size();
+    if (count >= npos) return false;
+    const uint32_t nodes = static_cast<uint32_t>(count);
+    vector<uint64_t> ids(nodes);
+    vector<int16_t> years(nodes);
+    cache.for_each([&](const size_t v, const WorkRecord& rec) {
+        ids[v] = rec.id.value;
+        years[v] = static_cast<int16_t>(clamp(rec.year, int32_t(INT16_MIN), int32_t(INT16_MAX)));
+    }, threads);
+    // a record that could not be read would leave a hole in the ID table
+    if (adjacent_find(ids.begin(), ids.end(), greater_equal<uint64_t>()) != ids.end()) return false;
+
+    // references of one work as sorted, distinct nodes; references to works outside the graph are dropped
+    auto map_refs = [&](const WorkRecord& rec, vector<uint32_t>& refs) {
+        refs.clear();
+        for (const WorkId ref : rec.refs) {
+            auto it = lower_bound(ids.begin(), ids.end(), ref.value);
+            if (it != ids.end() && *it == ref.value) refs.push_back(static_cast<uint32_t>(it - ids.begin()));
+        }
+        sort(refs.begin(), refs.end());
+        refs.erase(unique(refs.begin(), refs.end()), refs.end());
+    };
+
+    // references in two passes: count each node's edges, then write them straight into place
+    vector<uint64_t> out_offsets(nodes + 1, 0);
+    cache.for_each([&](const size_t v, const WorkRecord& rec) {
+        thread_local vector<uint32_t> refs;
+        map_refs(rec, refs);
+        out_offsets[v + 1] = refs.size();
+    }, threads);
+    for (uint32_t v = 0; v < nodes; v++) out_offsets[v + 1] += out_offsets[v];
+    const uint64_t edges = out_offsets[nodes];
+    vector<uint32_t> out_edges(edges);
+    cache.for_each([&](const size_t v, const WorkRecord& rec) {
+        thread_local vector<uint32_t> refs;
+        map_refs(rec, refs);
+        copy(refs.begin(), refs.end(), out_edges.begin() + out_offsets[v]);
+    }, threads);
+
+    return write(path, ids, years, out_offsets, out_edges, compress, threads);
+}
+
+bool LocalGraph::write(const string& path, const vector<uint64_t>& ids, const vector<int16_t>& years,
+                       vector<uint64_t>& out_offsets, vector<uint32_t>& out_edges,
+                       const bool compress, const size_t threads, const DeltaMark applied) {
+    if (ids.size() >= npos) return false;
+    const uint32_t nodes = static_cast<uint32_t>(ids.size());
+    const uint64_t edges = out_offsets[nodes];
+
+    // each section is built just before it is written and freed right after, so no more than both edge
+    // directions are held at once; the header and section table are filled in once all sections are written
+    const string file = file_name(path, latest_generation(path) + 1);
+    const string tmp_path = file + ".tmp";
+    ofstream out(tmp_path, ios::binary | ios::trunc);
+    struct Placed { uint32_t kind; uint64_t offset, length; };
+    vector<Placed> placed;
+    const uint32_t sections = 6 + (applied.generation ? 1 : 0) + (compress ? 1 : 0);
+    const string table(graph_header + sections * section_entry, '\0');
+    out.write(table.data(), static_cast<streamsize>(table.size()));
+    auto begin_section = [&](const uint32_t kind) {
+        static const char zeros[8] = {};
+        const uint64_t offset = static_cast<uint64_t>(out.tellp());
+        out.write(zeros, static_cast<streamsize>((8 - offset % 8) % 8));
+        placed.push_back({kind, static_cast<uint64_t>(out.tellp()), 0});
+    };
+    auto end_section = [&] {
+        placed.back().length = static_cast<uint64_t>(out.tellp()) - placed.back().offset;
+    };
+    auto write_section = [&]<typename T>(const uint32_t kind, const vector<T>& values) {
+        begin_section(kind);
+        out.write(reinterpret_cast<const char*>(values.data()), static_cast<streamsize>(values.size() * sizeof(T)));
+        end_section();
+    };
+
+    vector<uint64_t> in_offsets;
+    vector<uint32_t> in_edges;
+    if (compress) {
+        // compressed lists are only as short as the gaps in them, so compressed graphs are renumbered to keep
+        // neighbours close; the nodes in ID order are then recorded, since the ID array no longer is
+        reverse_edges(out_offsets, out_edges, in_offsets, in_edges, threads);
+        const vector<uint32_t> order = locality_order(out_offsets, out_edges, in_offsets, in_edges);
+        in_offsets = vector<uint64_t>();
+        in_edges = vector<uint32_t>();
+        // the old numbers are the ID order, so each one's new number is the ID index
+        vector<uint32_t> id_index(nodes);
+        for (uint32_t v = 0; v < nodes; v++) id_index[order[v]] = v;
+        {
+            vector<uint64_t> node_ids(nodes);
+            for (uint32_t v = 0; v < nodes; v++) node_ids[v] = ids[order[v]];
+            write_section(IDS, node_ids);
+        }
+        {
+            vector<int16_t> node_years(nodes);
+            for (uint32_t v = 0; v < nodes; v++) node_years[v] = years[order[v]];
+            write_section(YEARS, node_years);
+        }
+        write_section(ID_INDEX, id_index);
+        renumber_edges(out_offsets, out_edges, order, id_index, threads);
+    } else {
+        write_section(IDS, ids);
+        write_section(YEARS, years);
+    }
+
+    // references, then citations derived from them; the edge offsets of the references are still needed for
+    // that, so the byte offsets of compressed lists go into a separate array
+    {
+        vector<uint64_t> byte_offsets;
+        begin_section(compress ? OUT_EDGES_GV : OUT_EDGES);
+        if (compress) write_compressed(out, out_offsets, out_edges, byte_offsets, threads);
+        else out.write(reinterpret_cast<const char*>(out_edges.data()), static_cast<streamsize>(edges * 4));
+        end_section();
+        write_section(OUT_OFFSETS, compress ? byte_offsets : out_offsets);
+    }
+    reverse_edges(out_offsets, out_edges, in_offsets, in_edges, threads);
+    out_offsets = vector<uint64_t>();
+    out_edges = vector<uint32_t>();
+    {
+        vector<uint64_t> byte_offsets;
+        begin_section(compress ? IN_EDGES_GV : IN_EDGES);
+        if (compress) write_compressed(out, in_offsets, in_edges, byte_offsets, threads);
+        else out.write(reinterpret_cast<const char*>(in_edges.data()), static_cast<streamsize>(edges * 4));
+        end_section();
+        in_edges = vector<uint32_t>();
+        write_section(IN_OFFSETS, compress ? byte_offsets : in_offsets);
+    }
+    if (applied.generation) write_section(DELTA_MARK, vector<uint64_t>{applied.generation, applied.offset});
+
+    out.seekp(0);
+    out.write(graph_magic, 4);
+    write_raw(out, graph_version);
+    write_raw(out, uint64_t(nodes));
+    write_raw(out, edges);
+    write_raw(out, sections);
+    write_raw(out, uint32_t(0));
+    for (const auto& section : placed) {
+        write_raw(out, section.kind);
+        write_raw(out, uint32_t(0));
+        write_raw(out, section.offset);
+        write_raw(out, section.length);
+    }
+    out.close();
+    if (!out) return false;
+
+    // only renamed to its generation's name once complete, so readers never map a half-written file
+    error_code ec;
+    filesystem::rename(tmp_path, file, ec);
+    return !ec;
+}
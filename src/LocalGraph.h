@@ -0,0 +1,113 @@
+#ifndef LOCALGRAPH_H
+#define LOCALGRAPH_H
+
+#include <cstdint>
+#include <span>
+#include "GroupVarint.h"
+#include "MappedFile.h"
+#include "WorkCache.h"
+
+using namespace std;
+
+// position in a delta log (see GraphOverlay.h): the log's generation, and a byte offset into it
+struct DeltaMark {
+    uint64_t generation = 0;
+    uint64_t offset = 0;
+};
+
+// read-only citation graph in compressed sparse row form, memory mapped from the newest of its files
+// every write goes to a new file <path>.<generation>.kpg rather than over the old one, which may still be mapped
+// by searches (and cannot be replaced while it is, on Windows); <path>.kpg, as written before, is generation 0
+// nodes are numbered 0..node_count()-1, in order of their work IDs in plain graphs, so the sorted ID array doubles
+// as the ID → node table; compressed graphs number neighbours close together instead and keep the nodes in ID order
+// in a separate index; out-edges are references (newer → older), in-edges the same edges reversed (citations)
+// opening only maps the file and checks its header, so startup does not grow with the graph,
+// and several processes searching the same file share its pages
+// the edge lists are either plain u32 arrays or group varint compressed gaps (see GroupVarint.h), which need
+// between 1.25 and 5 bytes per edge depending on how close a work's neighbours are numbered, so mostly 1.25 to 2
+// once renumbered; compressed lists are decoded on the fly as they are visited
+class LocalGraph {
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    LocalGraph() = default;
+    explicit LocalGraph(const string& path);
+
+    // writes the next generation of the graph at path from every work in cache; references to works that are not in the cache are dropped
+    // compress selects the group varint edge encoding; returns false if the file could not be written
+    // the records are read, mapped to nodes and sorted into both edge directions on threads threads
+    static bool build(const string& path, WorkCache& cache, bool compress = false, size_t threads = 1);
+    // writes the next generation of the graph at path from nodes given by sorted ids and their years, and references in CSR form with each list sorted
+    // the citations are derived from them; out_offsets and out_edges are consumed
+    // compressed graphs are renumbered in the file, so their node numbers differ from the ones given
+    // applied records how much of the delta log the graph already contains
+    static bool write(const string& path, const vector<uint64_t>& ids, const vector<int16_t>& years,
+                      vector<uint64_t>& out_offsets, vector<uint32_t>& out_edges,
+                      bool compress, size_t threads, DeltaMark applied = {});
+
+    // the file of a generation of the graph at path
+    static string   file_name(const string& path, uint64_t generation);
+    // the newest generation of the graph at path that has a file, 0 if there is none
+    static uint64_t latest_generation(const string& path);
+    // removes the files of the generations before generation; files still mapped on Windows stay, for a later call
+    static void     remove_generations(const string& path, uint64_t generation);
+
+    // false if the file is missing, truncated, or of another version
+    bool     is_open()    const { return node_count_ != 0; }
+    bool     compressed() const { return out_bytes_ != nullptr; }
+    uint32_t node_count() const { return node_count_; }
+    uint64_t edge_count() const { return edge_count_; }
+    // the generation this graph was opened from
+    uint64_t generation() const { return generation_; }
+    // how much of the delta log was folded in when the graph was written; generation 0 for none
+    DeltaMark delta_mark() const { return delta_mark_; }
+
+    // node of id, or npos if the work is not in the graph
+    uint32_t find(WorkId id) const;
+    // node with the i-th smallest work ID
+    uint32_t by_id(uint32_t i) const { return id_index_ ? id_index_[i] : i; }
+    WorkId   id(uint32_t v)   const { return WorkId(ids_[v]); }
+    int32_t  year(uint32_t v) const { return years_[v]; }
+    // works referenced by v, in ascending order
+    // plain lists are returned in place; compressed ones are decoded into buffer, which the span then points into
+    span<const uint32_t> out_edges(uint32_t v, vector<uint32_t>& buffer) const {
+        if (out_bytes_) {
+            group_varint_decode(out_bytes_ + out_offsets_[v], buffer);
+            return buffer;
+        }
+        return {out_edges_ + out_offsets_[v], out_edges_ + out_offsets_[v + 1]};
+    }
+    // works citing v, in ascending order; as out_edges
+    span<const uint32_t> in_edges(uint32_t v, vector<uint32_t>& buffer) const {
+        if (in_bytes_) {
+            group_varint_decode(in_bytes_ + in_offsets_[v], buffer);
+            return buffer;
+        }
+        return {in_edges_ + in_offsets_[v], in_edges_ + in_offsets_[v + 1]};
+    }
+    // lengths of those lists, without decoding them
+    uint64_t out_degree(uint32_t v) const {
+        return out_bytes_ ? group_varint_length(out_bytes_ + out_offsets_[v]) : out_offsets_[v + 1] - out_offsets_[v];
+    }
+    uint64_t in_degree(uint32_t v) const {
+        return in_bytes_ ? group_varint_length(in_bytes_ + in_offsets_[v]) : in_offsets_[v + 1] - in_offsets_[v];
+    }
+private:
+    uint64_t        generation_ = 0;
+    MappedFile      file_;
+    uint32_t        node_count_ = 0;
+    uint64_t        edge_count_ = 0;
+    DeltaMark       delta_mark_;
+    const uint64_t* ids_ = nullptr;
+    const uint32_t* id_index_ = nullptr; // nodes in ID order, if they are not numbered that way
+    const int16_t*  years_ = nullptr;
+    const uint64_t* out_offsets_ = nullptr;
+    const uint32_t* out_edges_ = nullptr;
+    const uint64_t* in_offsets_ = nullptr;
+    const uint32_t* in_edges_ = nullptr;
+    // compressed edge lists; the offsets are then byte offsets into these
+    const uint8_t*  out_bytes_ = nullptr;
+    const uint8_t*  in_bytes_ = nullptr;
+};
+
+#endif //LOCALGRAPH_H
@@ -0,0 +1,91 @@
+#include "MappedFile.h"
+#include <utility>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const string& path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        return;
+    }
+    file_ = file;
+    open_ = true;
+    size_ = static_cast<size_t>(file_size.QuadPart);
+    if (size_ == 0) return; // empty files cannot be mapped
+    mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_) data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (!data_) close();
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return;
+    }
+    open_ = true;
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ != 0) { // empty files cannot be mapped
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            open_ = false;
+            size_ = 0;
+        } else {
+            data_ = static_cast<const char*>(p);
+        }
+    }
+    ::close(fd); // the mapping keeps its own reference to the file
+#endif
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        swap(open_, other.open_);
+        swap(data_, other.data_);
+        swap(size_, other.size_);
+#ifdef _WIN32
+        swap(file_, other.file_);
+        swap(mapping_, other.mapping_);
+#endif
+    }
+    return *this;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    if (file_) CloseHandle(file_);
+    file_ = nullptr;
+    mapping_ = nullptr;
+#else
+    if (data_) munmap(const_cast<char*>(data_), size_);
+#endif
+    open_ = false;
+    data_ = nullptr;
+    size_ = 0;
+}
@@ -0,0 +1,36 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+using namespace std;
+
+// read-only memory mapping of a whole file (mmap on POSIX, MapViewOfFile on Windows)
+// the pages are shared through the OS page cache, so opening is cheap and nothing is parsed up front
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const string& path);
+    ~MappedFile();
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // false if the file does not exist or could not be mapped; an empty file is open with size 0
+    bool        is_open() const { return open_; }
+    const char* data()    const { return data_; }
+    size_t      size()    const { return size_; }
+    void        close();
+private:
+    bool        open_ = false;
+    const char* data_ = nullptr;
+    size_t      size_ = 0;
+#ifdef _WIN32
+    void*       file_ = nullptr;
+    void*       mapping_ = nullptr;
+#endif
+};
+
+#endif //MAPPEDFILE_H
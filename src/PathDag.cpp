@@ -0,0 +1,163 @@
+#include "PathDag.h"
+#include <algorithm>
+#include "FlatMap.h"
+
+PathCount::PathCount(uint64_t value) {
+    for (; value; value >>= 32) limbs_.push_back(static_cast<uint32_t>(value));
+}
+
+PathCount& PathCount::operator+=(const PathCount& other) {
+    if (limbs_.size() < other.limbs_.size()) limbs_.resize(other.limbs_.size());
+    uint64_t carry = 0;
+    for (size_t i = 0; i < limbs_.size(); i++) {
+        carry += uint64_t(limbs_[i]) + (i < other.limbs_.size() ? other.limbs_[i] : 0);
+        limbs_[i] = static_cast<uint32_t>(carry);
+        carry >>= 32;
+        if (!carry && i >= other.limbs_.size()) break;
+    }
+    if (carry) limbs_.push_back(static_cast<uint32_t>(carry));
+    return *this;
+}
+
+string PathCount::to_string() const {
+    if (limbs_.empty()) return "0";
+    // peel off nine decimal digits at a time
+    vector<uint32_t> rest = limbs_;
+    vector<uint32_t> chunks;
+    while (!rest.empty()) {
+        uint64_t remainder = 0;
+        for (size_t i = rest.size(); i-- > 0; ) {
+            const uint64_t current = (remainder << 32) | rest[i];
+            rest[i] = static_cast<uint32_t>(current / 1'000'000'000);
+            remainder = current % 1'000'000'000;
+        }
+        chunks.push_back(static_cast<uint32_t>(remainder));
+        while (!rest.empty() && rest.back() == 0) rest.pop_back();
+    }
+    string digits = std::to_string(chunks.back());
+    for (size_t i = chunks.size() - 1; i-- > 0; ) {
+        const string chunk = std::to_string(chunks[i]);
+        digits += string(9 - chunk.size(), '0') + chunk;
+    }
+    return digits;
+}
+
+PathDag PathDag::build(const WorkId start, const WorkId target, const size_t max_hops, const size_t max_size,
+                       const RefPrefetch& prefetch, const RefLookup& refs, const size_t expected_nodes) {
+    return build_nodes<WorkId>(start, target, max_hops, max_size, prefetch, refs, [](const WorkId id) { return id; },
+                               expected_nodes);
+}
+
+PathDag PathDag::build(const uint32_t start, const uint32_t target, const size_t max_hops, const size_t max_size,
+                       const NodeRefLookup& refs, const function<WorkId(uint32_t)>& id, const size_t expected_nodes) {
+    return build_nodes<uint32_t>(start, target, max_hops, max_size, [](const vector<uint32_t>&) {}, refs, id,
+                                 expected_nodes);
+}
+
+// Node is a WorkId over the API and a node index over the local graph
+template <typename Node>
+PathDag PathDag::build_nodes(const Node start, const Node target, const size_t max_hops, const size_t max_size,
+                             const function<void(const vector<Node>&)>& prefetch,
+                             const function<const vector<Node>&(Node)>& refs,
+                             const function<WorkId(Node)>& id, const size_t expected_nodes) {
+    // every work reached, numbered in bfs order, with its distance and its predecessors one level up
+    FlatMap<Node, uint32_t> index(expected_nodes);
+    vector<Node> ids{start};
+    vector<uint32_t> distance{0};
+    vector<vector<uint32_t>> preds(1);
+    index[start] = 0;
+
+    vector<uint32_t> level{0};
+    vector<Node> level_ids;
+    size_t budget = max_size;
+    for (size_t hops = 0; hops < max_hops && !level.empty() && budget && !index.contains(target); ++hops) {
+        // the works past the budget are neither fetched nor expanded
+        if (level.size() > budget) level.resize(budget);
+        budget -= level.size();
+        level_ids.clear();
+        for (const uint32_t u : level) level_ids.push_back(ids[u]);
+        prefetch(level_ids);
+
+        // the whole level is expanded even once target turns up, so that all of its predecessors are found
+        vector<uint32_t> next_level;
+        for (const uint32_t u : level) {
+            for (const Node w : refs(ids[u])) {
+                auto [it, added] = index.try_emplace(w, static_cast<uint32_t>(ids.size()));
+                const uint32_t v = it->second;
+                if (added) {
+                    ids.push_back(w);
+                    distance.push_back(distance[u] + 1);
+                    preds.emplace_back();
+                    next_level.push_back(v);
+                }
+                // a work listing the same reference twice still adds one path
+                if (distance[v] == distance[u] + 1 && (preds[v].empty() || preds[v].back() != u))
+                    preds[v].push_back(u);
+            }
+        }
+        level.swap(next_level);
+    }
+
+    PathDag dag;
+    auto found = index.find(target);
+    if (found == index.end()) return dag;
+
+    // keep only the works target can be traced back through; they keep their bfs order, so preds come first
+    // and target, the only one of them at its distance, comes last
+    vector<char> on_path(ids.size());
+    on_path[found->second] = 1;
+    for (size_t v = ids.size(); v-- > 0; ) {
+        if (!on_path[v]) continue;
+        for (const uint32_t u : preds[v]) on_path[u] = 1;
+    }
+    vector<uint32_t> renumber(ids.size());
+    for (size_t v = 0; v < ids.size(); v++) {
+        if (!on_path[v]) continue;
+        renumber[v] = static_cast<uint32_t>(dag.ids_.size());
+        dag.ids_.push_back(id(ids[v]));
+        dag.preds_.emplace_back();
+        for (const uint32_t u : preds[v]) dag.preds_.back().push_back(renumber[u]);
+    }
+    dag.hops_ = distance[found->second];
+
+    // paths to each work: the sum over its predecessors, which all come before it
+    dag.counts_.resize(dag.ids_.size());
+    dag.counts_[0] = 1;
+    for (size_t v = 1; v < dag.ids_.size(); v++) {
+        for (const uint32_t u : dag.preds_[v]) dag.counts_[v] += dag.counts_[u];
+    }
+    return dag;
+}
+
+// follows the first predecessor of every work from v back to start
+void PathDag::Paths::descend(uint32_t v) {
+    while (v != 0) {
+        stack_.push_back({v, 0});
+        v = dag_->preds_[v][0];
+    }
+}
+
+bool PathDag::Paths::next(vector<WorkId>& path) {
+    if (dag_->empty()) return false;
+    if (!started_) {
+        started_ = true;
+        descend(static_cast<uint32_t>(dag_->ids_.size() - 1));
+    } else {
+        // the work nearest start with another predecessor left takes it, and the path from there back to start is redone
+        while (!stack_.empty()) {
+            auto& [v, i] = stack_.back();
+            if (++i < dag_->preds_[v].size()) {
+                descend(dag_->preds_[v][i]);
+                break;
+            }
+            stack_.pop_back();
+        }
+        if (stack_.empty()) return false;
+    }
+
+    path.clear();
+    path.push_back(dag_->ids_[0]);
+    for (size_t j = stack_.size(); j-- > 0; )
+        path.push_back(dag_->ids_[stack_[j].first]);
+    return true;
+}
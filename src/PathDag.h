@@ -0,0 +1,82 @@
+#ifndef PATHDAG_H
+#define PATHDAG_H
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+#include "WorkRecord.h"
+
+using namespace std;
+
+// references of a work for searches that run over either the API or the local graph
+// prefetch is called with each bfs level before its references are read, so they can be fetched in batches
+using RefLookup = function<const vector<WorkId>&(WorkId)>;
+using RefPrefetch = function<void(const vector<WorkId>&)>;
+// references of a node of the local graph, for the searches that run on its node indices
+using NodeRefLookup = function<const vector<uint32_t>&(uint32_t)>;
+
+// unsigned integer of any size, for path counts, which double with every diamond on the way and soon pass 2^64
+class PathCount {
+public:
+    PathCount(uint64_t value = 0);
+    PathCount& operator+=(const PathCount& other);
+    bool operator==(const PathCount& other) const { return limbs_ == other.limbs_; }
+    // decimal digits
+    string to_string() const;
+private:
+    vector<uint32_t> limbs_; // least significant first, no leading zeros
+};
+
+// every shortest path start → target over references, as the DAG of each work's predecessors one hop nearer
+// the start; built in a single bfs, and enough to count the paths exactly and list them without searching again
+class PathDag {
+public:
+    // bfs level by level from start until the level reaching target is complete, or for at most max_hops levels
+    // and max_size expanded works, as graph_by_bfs; a level cut short by max_size only adds the paths through
+    // the works expanded before
+    // works not on a shortest path to target are dropped; empty() if there is no path
+    static PathDag build(WorkId start, WorkId target, size_t max_hops, size_t max_size,
+                         const RefPrefetch& prefetch, const RefLookup& refs, size_t expected_nodes = 0);
+    // the same over the nodes of the local graph, id giving the work ID of each
+    static PathDag build(uint32_t start, uint32_t target, size_t max_hops, size_t max_size,
+                         const NodeRefLookup& refs, const function<WorkId(uint32_t)>& id, size_t expected_nodes = 0);
+
+    bool             empty() const { return ids_.empty(); }
+    size_t           hops()  const { return hops_; }
+    // number of shortest paths
+    const PathCount& count() const { return counts_.empty() ? zero_ : counts_.back(); }
+    // the works on them, in order of distance from start: node 0 is start, the last node target
+    size_t           node_count() const { return ids_.size(); }
+    WorkId           id(size_t v) const { return ids_[v]; }
+    span<const uint32_t> preds(size_t v) const { return preds_[v]; }
+
+    // lists the paths one at a time, each from the last, without holding more than one
+    class Paths {
+    public:
+        explicit Paths(const PathDag& dag) : dag_(&dag) {}
+        // the next path start → target into path; false once every path has been listed
+        bool next(vector<WorkId>& path);
+    private:
+        void descend(uint32_t v);
+        const PathDag*               dag_;
+        bool                         started_ = false;
+        vector<pair<uint32_t,size_t>> stack_; // (node, which of its preds) from target back towards start
+    };
+    Paths paths() const { return Paths(*this); }
+private:
+    template <typename Node>
+    static PathDag build_nodes(Node start, Node target, size_t max_hops, size_t max_size,
+                               const function<void(const vector<Node>&)>& prefetch,
+                               const function<const vector<Node>&(Node)>& refs,
+                               const function<WorkId(Node)>& id, size_t expected_nodes);
+
+    vector<WorkId>           ids_;
+    vector<vector<uint32_t>> preds_;
+    vector<PathCount>        counts_;
+    size_t                   hops_ = 0;
+    static inline const PathCount zero_;
+};
+
+#endif //PATHDAG_H
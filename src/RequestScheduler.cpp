@@ -0,0 +1,115 @@
+#include "RequestScheduler.h"
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <thread>
+
+// first retry waits about this long, doubling with every attempt up to max_backoff
+static const chrono::milliseconds base_backoff(500);
+static const chrono::milliseconds max_backoff(30000);
+
+RequestScheduler& request_scheduler() {
+    static RequestScheduler scheduler(10.0, 10.0, 6);
+    return scheduler;
+}
+
+RequestScheduler::RequestScheduler(const double rate, const double burst, const int max_attempts)
+    : rate_(rate), burst_(burst), max_attempts_(max_attempts), tokens_(burst),
+      last_refill_(clock::now()), paused_until_(clock::now()) {}
+
+// value percent-encoded for a query string: everything but unreserved characters (RFC 3986), so an address
+// with + or & in it stays one parameter
+static string url_encode(const string& value) {
+    static const char hex[] = "0123456789ABCDEF";
+    string encoded;
+    for (const unsigned char c : value) {
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            encoded += static_cast<char>(c);
+        } else {
+            encoded += '%';
+            encoded += hex[c >> 4];
+            encoded += hex[c & 15];
+        }
+    }
+    return encoded;
+}
+
+void RequestScheduler::set_mailto(const string& email) {
+    lock_guard<mutex> lock(mutex_);
+    mailto_ = url_encode(email);
+}
+
+void RequestScheduler::refill(const clock::time_point now) {
+    const double elapsed = chrono::duration<double>(now - last_refill_).count();
+    tokens_ = min(burst_, tokens_ + elapsed * rate_);
+    last_refill_ = now;
+}
+
+void RequestScheduler::acquire(const Lane lane) {
+    unique_lock<mutex> lock(mutex_);
+    if (lane == Lane::CRITICAL) critical_waiting_++;
+    while (true) {
+        const auto now = clock::now();
+        refill(now);
+        const bool yield = (lane == Lane::PREFETCH && critical_waiting_ > 0);
+        if (!yield && now >= paused_until_ && tokens_ >= 1.0) {
+            tokens_ -= 1.0;
+            break;
+        }
+        if (yield) {
+            cv_.wait(lock); // woken when a critical request has its token
+            continue;
+        }
+        // sleep until the next token is due
+        auto wake = now + chrono::duration_cast<clock::duration>(chrono::duration<double>((1.0 - min(tokens_, 1.0)) / rate_));
+        cv_.wait_until(lock, max(wake, paused_until_));
+    }
+    if (lane == Lane::CRITICAL) {
+        critical_waiting_--;
+        cv_.notify_all();
+    }
+}
+
+chrono::milliseconds RequestScheduler::retry_delay(const int attempt, const string& retry_after, mt19937& rng) {
+    // full jitter, so parallel workers do not retry in lockstep
+    const auto backoff = min(max_backoff, base_backoff * (1 << min(attempt, 16)));
+    auto delay = chrono::milliseconds(uniform_int_distribution<long long>(0, backoff.count())(rng));
+    // the HTTP-date form is not used by the API
+    if (!retry_after.empty() && retry_after.size() < 10
+        && all_of(retry_after.begin(), retry_after.end(), [](unsigned char c) { return isdigit(c); }))
+        delay = max(delay, chrono::milliseconds(stoll(retry_after) * 1000));
+    return delay;
+}
+
+httplib::Result RequestScheduler::get(httplib::SSLClient& cli, const string& path, const Lane lane) {
+    string request_str = path;
+    {
+        lock_guard<mutex> lock(mutex_);
+        if (!mailto_.empty())
+            request_str += (path.find('?') == string::npos ? "?mailto=" : "&mailto=") + mailto_;
+    }
+
+    thread_local mt19937 rng(random_device{}());
+    httplib::Result res;
+    for (int attempt = 0; attempt < max_attempts_; attempt++) {
+        acquire(lane);
+        // responses come gzipped, which cuts the transfer several times over; httplib inflates them into res->body
+        res = cli.Get(request_str, {{"Accept-Encoding", "gzip"}});
+        if (res && res->status != 429 && res->status < 500) return res; // done, or not worth retrying
+        if (attempt + 1 == max_attempts_) break;
+
+        // a 503 asks for a pause with Retry-After just as a 429 does
+        const bool told = res && (res->status == 429 || res->status == 503) && res->has_header("Retry-After");
+        const auto delay = retry_delay(attempt, told ? res->get_header_value("Retry-After") : "", rng);
+        if (told) {
+            // everyone backs off, not just this request
+            lock_guard<mutex> lock(mutex_);
+            paused_until_ = max(paused_until_, clock::now() + delay);
+            tokens_ = 0.0;
+        }
+        cout << (res && res->status == 429 ? "Rate Limited!" : "Request Failed!") << " Retrying in "
+             << delay.count() << " ms" << endl;
+        this_thread::sleep_for(delay);
+    }
+    return res;
+}
@@ -0,0 +1,58 @@
+#ifndef REQUESTSCHEDULER_H
+#define REQUESTSCHEDULER_H
+
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#define CPPHTTPLIB_ZLIB_SUPPORT
+#include "cpp-httplib/httplib.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <string>
+
+using namespace std;
+
+// priority of a request; search-critical requests always get the next token before background prefetches
+enum class Lane {
+    CRITICAL,
+    PREFETCH
+};
+
+// paces and retries every request to the API, shared by all clients and threads
+// - token bucket: on average at most rate requests per second, in bursts of at most burst
+// - 429, 5xx and dropped connections are retried with jittered exponential backoff;
+//   a Retry-After header on a 429 or 503 pauses every lane for at least that long
+// - responses are requested gzip-compressed
+// - with a mailto address set, requests are served from OpenAlex's polite pool
+class RequestScheduler {
+public:
+    RequestScheduler(double rate, double burst, int max_attempts);
+    void set_mailto(const string& email);
+    // GETs path on cli once a token is available; returns the last response if every attempt failed
+    httplib::Result get(httplib::SSLClient& cli, const string& path, Lane lane = Lane::CRITICAL);
+    // takes a token for one request in lane, waiting until one is due; get() does this before every attempt
+    void acquire(Lane lane);
+    // wait before the retry after attempt (counted from 0): anywhere up to the exponential backoff, and at least
+    // retry_after seconds if it holds a Retry-After header's number of seconds
+    static chrono::milliseconds retry_delay(int attempt, const string& retry_after, mt19937& rng);
+private:
+    using clock = chrono::steady_clock;
+    void refill(clock::time_point now);
+
+    double             rate_;
+    double             burst_;
+    int                max_attempts_;
+    string             mailto_;
+    mutex              mutex_;
+    condition_variable cv_;
+    double             tokens_;
+    clock::time_point  last_refill_;
+    clock::time_point  paused_until_;
+    size_t             critical_waiting_ = 0;
+};
+
+// the scheduler used by the helpers in openalex.cpp; OpenAlex's limits apply per client, so there is one per process
+// tuned to the documented limit of 10 requests per second
+RequestScheduler& request_scheduler();
+
+#endif //REQUESTSCHEDULER_H
@@ -0,0 +1,341 @@
+#include "WorkCache.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <queue>
+#include <thread>
+
+// file layout, all integers little-endian
+//   .dat: "KPWD" u32 version, then records:
+//         u64 id | i32 year | u32 fields | u32 n_refs | u32 n_concepts | u32 title_len
+//         | u64 refs[n_refs] | (u64 id, f32 score)[n_concepts] | title bytes
+//   .idx: "KPWI" u32 version u64 count u64 indexed, then count × (u64 id, u64 offset) sorted by id
+//         indexed is the size of .dat when it was written: records past it are indexed by scanning them on open
+static const char     data_magic[4]  = {'K', 'P', 'W', 'D'};
+static const char     index_magic[4] = {'K', 'P', 'W', 'I'};
+static const uint32_t cache_version  = 1;
+static const uint32_t index_version  = 2;
+static const size_t   data_header    = 8;
+static const size_t   index_header   = 24;
+static const size_t   record_header  = 28;
+
+template <typename T>
+static void put_raw(string& out, const T& v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template <typename T>
+static T get_raw(const char* p) {
+    T v;
+    memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+// appends the bytes of rec to out
+static void encode_record(const WorkRecord& rec, string& out) {
+    out.reserve(out.size() + record_header + rec.refs.size() * 8 + rec.concepts.size() * 12 + rec.title.size());
+    put_raw(out, rec.id.value);
+    put_raw(out, rec.year);
+    put_raw(out, rec.fields);
+    put_raw(out, static_cast<uint32_t>(rec.refs.size()));
+    put_raw(out, static_cast<uint32_t>(rec.concepts.size()));
+    put_raw(out, static_cast<uint32_t>(rec.title.size()));
+    for (WorkId ref : rec.refs) put_raw(out, ref.value);
+    for (const auto& c : rec.concepts) {
+        put_raw(out, c.id);
+        put_raw(out, c.score);
+    }
+    out += rec.title;
+}
+
+WorkCache::WorkCache(const string& path) : path_(path) {
+    open_files();
+}
+
+WorkCache::~WorkCache() {
+    flush();
+}
+
+void WorkCache::open_files() {
+    const string data_path = path_ + ".dat";
+    data_ = MappedFile(data_path);
+    if (!data_.is_open() || data_.size() < data_header || memcmp(data_.data(), data_magic, 4) != 0
+        || get_raw<uint32_t>(data_.data() + 4) != cache_version) {
+        // missing or unreadable: start over with an empty data file
+        data_.close();
+        ofstream create(data_path, ios::binary | ios::trunc);
+        create.write(data_magic, 4);
+        create.write(reinterpret_cast<const char*>(&cache_version), 4);
+        create.close();
+        data_ = MappedFile(data_path);
+        filesystem::remove(path_ + ".idx");
+    }
+    // runs left by a session that ended before merging them; their records are in the tail scanned below
+    for (size_t run = 0; filesystem::remove(path_ + ".run" + to_string(run)); run++) {}
+
+    index_ = MappedFile(path_ + ".idx");
+    uint64_t offset = data_header;
+    if (index_.is_open() && index_.size() >= index_header && memcmp(index_.data(), index_magic, 4) == 0
+        && get_raw<uint32_t>(index_.data() + 4) == index_version
+        && index_.size() == index_header + get_raw<uint64_t>(index_.data() + 8) * sizeof(IndexEntry)
+        && get_raw<uint64_t>(index_.data() + 16) <= data_.size())
+        offset = get_raw<uint64_t>(index_.data() + 16);
+    else
+        index_.close();
+
+    // records appended after the last flush, as when the last session did not shut down cleanly, or all of them
+    // without a usable index: they are indexed by scanning them, and the next flush writes them into the index
+    while (offset + record_header <= data_.size()) {
+        const char* p = data_.data() + offset;
+        const uint64_t len = record_header + get_raw<uint32_t>(p + 16) * 8ull
+                           + get_raw<uint32_t>(p + 20) * 12ull + get_raw<uint32_t>(p + 24);
+        if (offset + len > data_.size()) break;
+        appended_[get_raw<uint64_t>(p)] = offset;
+        offset += len;
+    }
+    // a record torn by a crash is cut off, or the records appended after it would be read from its bytes
+    if (offset < data_.size()) {
+        data_.close();
+        filesystem::resize_file(data_path, offset);
+        data_ = MappedFile(data_path);
+    }
+    data_size_ = data_.size();
+    append_.open(data_path, ios::binary | ios::app);
+}
+
+const WorkCache::IndexEntry* WorkCache::index_begin() const {
+    return reinterpret_cast<const IndexEntry*>(index_.data() + index_header);
+}
+
+size_t WorkCache::index_count() const {
+    return index_.size() ? (index_.size() - index_header) / sizeof(IndexEntry) : 0;
+}
+
+bool WorkCache::read_record(const uint64_t offset, WorkRecord& rec) const {
+    if (offset + record_header > data_.size()) return false;
+    const char* p = data_.data() + offset;
+    const uint32_t n_refs = get_raw<uint32_t>(p + 16);
+    const uint32_t n_concepts = get_raw<uint32_t>(p + 20);
+    const uint32_t title_len = get_raw<uint32_t>(p + 24);
+    if (offset + record_header + n_refs * 8ull + n_concepts * 12ull + title_len > data_.size()) return false;
+
+    rec.id = WorkId(get_raw<uint64_t>(p));
+    rec.year = get_raw<int32_t>(p + 8);
+    rec.fields = get_raw<uint32_t>(p + 12);
+    p += record_header;
+    rec.refs.resize(n_refs);
+    static_assert(sizeof(WorkId) == 8);
+    memcpy(rec.refs.data(), p, n_refs * 8ull);
+    p += n_refs * 8ull;
+    rec.concepts.resize(n_concepts);
+    for (uint32_t i = 0; i < n_concepts; i++, p += 12) {
+        rec.concepts[i] = {get_raw<uint64_t>(p), get_raw<float>(p + 8)};
+    }
+    rec.title.assign(p, title_len);
+    return true;
+}
+
+bool WorkCache::find(const uint64_t id, WorkRecord& rec) const {
+    if (auto it = recent_.find(id); it != recent_.end()) {
+        rec = it->second;
+        return true;
+    }
+    if (auto it = appended_.find(id); it != appended_.end())
+        return read_record(it->second, rec);
+
+    const IndexEntry* begin = index_begin();
+    const IndexEntry* end = begin + index_count();
+    const IndexEntry* it = lower_bound(begin, end, id, [](const IndexEntry& e, uint64_t v) { return e.id < v; });
+    return it != end && it->id == id && read_record(it->offset, rec);
+}
+
+bool WorkCache::get(const WorkId id, WorkRecord& rec) {
+    lock_guard<mutex> lock(mutex_);
+    return find(id.value, rec);
+}
+
+void WorkCache::put(const WorkRecord& rec) {
+    lock_guard<mutex> lock(mutex_);
+    put_locked(rec, false);
+}
+
+void WorkCache::put(span<const WorkRecord> recs, const bool replace) {
+    lock_guard<mutex> lock(mutex_);
+    for (const auto& rec : recs) {
+        put_locked(rec, replace);
+    }
+}
+
+void WorkCache::put_locked(const WorkRecord& rec, const bool replace) {
+    if (!rec.id || rec.id.is_interned()) return;
+    WorkRecord merged;
+    if (find(rec.id.value, merged) && merged.has(rec.fields) && !replace) return; // nothing new
+    merged.merge(rec);
+    merged.id = rec.id;
+
+    string bytes;
+    encode_record(merged, bytes);
+    append_.write(bytes.data(), static_cast<streamsize>(bytes.size()));
+    appended_[rec.id.value] = data_size_;
+    recent_[rec.id.value] = move(merged);
+    data_size_ += bytes.size();
+}
+
+void WorkCache::Writer::add(span<const WorkRecord> recs) {
+    bytes_.clear();
+    const size_t first = entries_.size();
+    for (const auto& rec : recs) {
+        if (!rec.id || rec.id.is_interned()) continue;
+        entries_.push_back({rec.id.value, bytes_.size()});
+        encode_record(rec, bytes_);
+    }
+    if (bytes_.empty()) return;
+    uint64_t base;
+    {
+        lock_guard<mutex> lock(cache_->mutex_);
+        base = cache_->data_size_;
+        if (first == 0) {
+            unindexed_ = base;
+            cache_->unindexed_.insert(base);
+        }
+        cache_->append_.write(bytes_.data(), static_cast<streamsize>(bytes_.size()));
+        cache_->data_size_ += bytes_.size();
+    }
+    for (size_t i = first; i < entries_.size(); i++) entries_[i].offset += base;
+    if (entries_.size() >= run_entries) finish();
+}
+
+void WorkCache::Writer::finish() {
+    if (entries_.empty()) return;
+    // a work added twice keeps its later record: within an id the latest entry comes first, which is the one
+    // flush() keeps
+    sort(entries_.begin(), entries_.end(), [](const IndexEntry& a, const IndexEntry& b) {
+        return a.id != b.id ? a.id < b.id : a.offset > b.offset;
+    });
+    string run_path;
+    {
+        lock_guard<mutex> lock(cache_->mutex_);
+        run_path = cache_->path_ + ".run" + to_string(cache_->next_run_++);
+    }
+    ofstream out(run_path, ios::binary | ios::trunc);
+    out.write(reinterpret_cast<const char*>(entries_.data()), static_cast<streamsize>(entries_.size() * sizeof(IndexEntry)));
+    out.close();
+    entries_.clear();
+    lock_guard<mutex> lock(cache_->mutex_);
+    cache_->runs_.push_back(run_path);
+    cache_->unindexed_.erase(cache_->unindexed_.find(unindexed_));
+}
+
+void WorkCache::flush() {
+    lock_guard<mutex> lock(mutex_);
+    if (appended_.empty() && runs_.empty()) return;
+    append_.flush();
+
+    // every source is sorted by id: the old index, the runs of writers, and the records put since the last flush
+    // (only these need sorting); they are merged in one pass, so the index is written once however many runs
+    // there are
+    vector<IndexEntry> added;
+    added.reserve(appended_.size());
+    for (const auto& [id, offset] : appended_) {
+        added.push_back({id, offset});
+    }
+    sort(added.begin(), added.end(), [](const IndexEntry& a, const IndexEntry& b) { return a.id < b.id; });
+    vector<MappedFile> run_files;
+    run_files.reserve(runs_.size());
+    vector<span<const IndexEntry>> sources = {{index_begin(), index_count()}, added};
+    for (const string& run : runs_) {
+        run_files.emplace_back(run);
+        sources.push_back({reinterpret_cast<const IndexEntry*>(run_files.back().data()),
+                           run_files.back().size() / sizeof(IndexEntry)});
+    }
+
+    // of several entries for a work the latest record wins: records are only ever appended, so that is the one
+    // at the highest offset, and the heap hands it out first
+    using Head = pair<IndexEntry, size_t>; // next entry of a source, and the source
+    auto later = [](const Head& a, const Head& b) {
+        return a.first.id != b.first.id ? a.first.id > b.first.id : a.first.offset < b.first.offset;
+    };
+    priority_queue<Head, vector<Head>, decltype(later)> heads(later);
+    vector<size_t> next(sources.size(), 1);
+    for (size_t s = 0; s < sources.size(); s++) {
+        if (!sources[s].empty()) heads.push({sources[s][0], s});
+    }
+
+    // write beside the old index and swap it in, so a crash never leaves a torn index
+    const string tmp_path = path_ + ".idx.tmp";
+    {
+        ofstream out(tmp_path, ios::binary | ios::trunc);
+        uint64_t count = 0;
+        // records of writers that are not in a run yet are not in this index, so are left to the scan on open
+        const uint64_t indexed = unindexed_.empty() ? data_size_ : *unindexed_.begin();
+        out.write(index_magic, 4);
+        out.write(reinterpret_cast<const char*>(&index_version), 4);
+        out.write(reinterpret_cast<const char*>(&count), 8);
+        out.write(reinterpret_cast<const char*>(&indexed), 8);
+        uint64_t last = 0;
+        while (!heads.empty()) {
+            const auto [entry, s] = heads.top();
+            heads.pop();
+            if (next[s] < sources[s].size()) heads.push({sources[s][next[s]++], s});
+            if (count && entry.id == last) continue; // replaced by a newer record
+            out.write(reinterpret_cast<const char*>(&entry), sizeof(IndexEntry));
+            last = entry.id;
+            count++;
+        }
+        out.seekp(8);
+        out.write(reinterpret_cast<const char*>(&count), 8);
+    }
+    index_.close();
+    filesystem::rename(tmp_path, path_ + ".idx");
+    index_ = MappedFile(path_ + ".idx");
+
+    // remap the data file so the appended records are readable through the mapping
+    data_ = MappedFile(path_ + ".dat");
+    appended_.clear();
+    recent_.clear();
+    run_files.clear();
+    for (const string& run : runs_) {
+        filesystem::remove(run);
+    }
+    runs_.clear();
+}
+
+size_t WorkCache::size() {
+    lock_guard<mutex> lock(mutex_);
+    const IndexEntry* begin = index_begin();
+    const IndexEntry* end = begin + index_count();
+    size_t count = index_count();
+    for (const auto& entry : appended_) {
+        if (!binary_search(begin, end, IndexEntry{entry.first, 0},
+                           [](const IndexEntry& a, const IndexEntry& b) { return a.id < b.id; }))
+            count++;
+    }
+    return count;
+}
+
+size_t WorkCache::pending() {
+    lock_guard<mutex> lock(mutex_);
+    return appended_.size();
+}
+
+void WorkCache::for_each(const function<void(size_t, const WorkRecord&)>& visit, const size_t threads) {
+    flush();
+    // the mappings are only read from here on, so the ranges need no further locking
+    lock_guard<mutex> lock(mutex_);
+    const size_t count = index_count();
+    const size_t width = max<size_t>(1, min(threads, count));
+    auto visit_range = [&](const size_t t) {
+        WorkRecord rec;
+        for (size_t i = count * t / width; i < count * (t + 1) / width; i++) {
+            if (read_record(index_begin()[i].offset, rec)) visit(i, rec);
+        }
+    };
+    vector<thread> workers;
+    for (size_t t = 1; t < width; t++) {
+        workers.emplace_back(visit_range, t);
+    }
+    visit_range(0);
+    for (auto& w : workers) {
+        w.join();
+    }
+}
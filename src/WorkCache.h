@@ -0,0 +1,93 @@
+#ifndef WORKCACHE_H
+#define WORKCACHE_H
+
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include "MappedFile.h"
+#include "WorkRecord.h"
+
+using namespace std;
+
+// persistent cache of work records keyed by work ID, survives restarts
+// <path>.dat holds the records back to back, <path>.idx a table of (id, offset) sorted by id; both are memory mapped
+// records put during a session are appended to .dat right away and indexed by flush(), which also runs on destruction
+// records appended after the last flush, e.g. before a crash, are found by scanning the end of .dat on open
+// bulk loads go through a Writer per thread instead, whose index entries are sorted into runs of their own and
+// merged into the index with everything else by the next flush()
+// safe to use from several threads
+class WorkCache {
+    struct IndexEntry {
+        uint64_t id;
+        uint64_t offset;
+    };
+public:
+    explicit WorkCache(const string& path);
+    ~WorkCache();
+    WorkCache(const WorkCache&) = delete;
+    WorkCache& operator=(const WorkCache&) = delete;
+
+    // copies the cached record for id into rec; false if id is not cached
+    bool   get(WorkId id, WorkRecord& rec);
+    // stores rec under rec.id, merged into what is already cached for it; interned IDs are not persisted
+    void   put(const WorkRecord& rec);
+    // puts every record of recs, taking the lock once
+    // replace writes them even where the cache already has all their fields, e.g. for newer snapshot data
+    void   put(span<const WorkRecord> recs, bool replace = false);
+    // write the index for everything put so far
+    void   flush();
+    // number of cached works
+    size_t size();
+    // number of records put since the last flush; they are held in memory until then
+    size_t pending();
+    // one thread's bulk load, e.g. of snapshot partitions: records replace what the cache has for them outright,
+    // so they are not looked up first, and take the cache's lock only to append their bytes, once per add()
+    // the index entries pile up in the writer, and every run_entries of them are sorted and spilled to a run
+    // file; the records become visible to get() with the first flush() after the writer is done
+    class Writer {
+    public:
+        explicit Writer(WorkCache& cache) : cache_(&cache) {}
+        ~Writer() { finish(); }
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        void add(span<const WorkRecord> recs);
+        // spills the entries not in a run yet; the destructor calls it too
+        void finish();
+    private:
+        static constexpr size_t run_entries = 1 << 20;
+
+        WorkCache*         cache_;
+        string             bytes_;
+        vector<IndexEntry> entries_;
+        uint64_t           unindexed_ = 0; // offset of the first record of entries_
+    };
+    // calls visit(i, rec) with every cached record, i being its position in id order; flushes first
+    // with threads > 1 the records are split into that many contiguous ranges visited concurrently
+    void   for_each(const function<void(size_t, const WorkRecord&)>& visit, size_t threads = 1);
+private:
+    void              open_files();
+    bool              find(uint64_t id, WorkRecord& rec) const;
+    void              put_locked(const WorkRecord& rec, bool replace);
+    bool              read_record(uint64_t offset, WorkRecord& rec) const;
+    const IndexEntry* index_begin() const;
+    size_t            index_count() const;
+
+    string                             path_;
+    mutex                              mutex_;
+    MappedFile                         data_;
+    MappedFile                         index_;
+    ofstream                           append_;
+    uint64_t                           data_size_ = 0;
+    unordered_map<uint64_t,uint64_t>   appended_; // id → offset of records not yet in the index
+    unordered_map<uint64_t,WorkRecord> recent_;   // records appended past the end of the mapping
+    vector<string>                     runs_;     // run files of writers, each sorted by id
+    multiset<uint64_t>                 unindexed_; // offsets of the first records writers have not spilled yet
+    size_t                             next_run_ = 0;
+};
+
+#endif //WORKCACHE_H
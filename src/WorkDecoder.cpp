@@ -0,0 +1,218 @@
+#include "WorkDecoder.h"
+
+WorkRecord WorkBatch::record(const Work& w) const {
+    WorkRecord rec;
+    rec.id = w.id;
+    rec.year = w.year;
+    rec.fields = w.fields;
+    rec.refs.assign(refs.begin() + w.refs_begin, refs.begin() + w.refs_end);
+    rec.concepts.assign(concepts.begin() + w.concepts_begin, concepts.begin() + w.concepts_end);
+    rec.title = title_of(w);
+    return rec;
+}
+
+namespace {
+
+// SAX handler that tracks what kind of container each nesting level is and only acts on the fields we use
+class WorkSax : public nlohmann::json_sax<json> {
+public:
+    WorkSax(WorkBatch& batch, std::string* next_cursor, size_t* count)
+        : batch_(batch), next_cursor_(next_cursor), count_(count) {}
+
+    bool null() override {
+        if (top() == WORK && key_ == YEAR) set_year(0);
+        if (top() == WORK && key_ == TITLE) set_title("<no title>");
+        return true;
+    }
+    bool boolean(bool) override { return true; }
+    bool number_integer(number_integer_t v) override { return number(static_cast<double>(v)); }
+    bool number_unsigned(number_unsigned_t v) override { return number(static_cast<double>(v)); }
+    bool number_float(number_float_t v, const string_t&) override { return number(v); }
+    bool binary(binary_t&) override { return true; }
+
+    bool string(string_t& v) override {
+        switch (top()) {
+            case REFS:
+                if (WorkId ref = WorkId::parse(v)) batch_.refs.push_back(ref);
+                break;
+            case WORK:
+                if (key_ == ID) work().id = WorkId::from_string(v);
+                else if (key_ == TITLE) set_title(v);
+                break;
+            case CONCEPT:
+                if (key_ == ID) batch_.concepts.back().id = openalex_num(v);
+                break;
+            case META:
+                if (key_ == NEXT_CURSOR && next_cursor_) *next_cursor_ = v;
+                break;
+            default:
+                break;
+        }
+        return true;
+    }
+
+    bool start_object(size_t) override {
+        Context parent = top();
+        if (depth_ == 0) {
+            push(ROOT);
+        } else if (parent == RESULTS) {
+            open_work();
+            push(WORK);
+        } else if (parent == CONCEPTS) {
+            batch_.concepts.push_back({0, 0.0f});
+            push(CONCEPT);
+        } else if (parent == ROOT && key_ == META_KEY) {
+            push(META);
+        } else {
+            push(SKIP);
+        }
+        key_ = OTHER;
+        return true;
+    }
+
+    bool end_object() override {
+        if (top() == WORK || (top() == ROOT && root_is_work_)) close_work();
+        pop();
+        key_ = OTHER;
+        return true;
+    }
+
+    bool start_array(size_t) override {
+        Context parent = top();
+        if (parent == ROOT && key_ == RESULTS_KEY) {
+            push(RESULTS);
+        } else if (parent == WORK && key_ == REFS_KEY) {
+            work().fields |= WorkRecord::REFS;
+            push(REFS);
+        } else if (parent == WORK && key_ == CONCEPTS_KEY) {
+            work().fields |= WorkRecord::CONCEPTS;
+            push(CONCEPTS);
+        } else {
+            push(SKIP);
+        }
+        return true;
+    }
+
+    bool end_array() override {
+        pop();
+        key_ = OTHER;
+        return true;
+    }
+
+    bool key(string_t& k) override {
+        key_ = OTHER;
+        switch (top()) {
+            case ROOT:
+                if (k == "results") key_ = RESULTS_KEY;
+                else if (k == "meta") key_ = META_KEY;
+                else if (is_work_key(k)) {
+                    // a single work object rather than a list response
+                    if (!root_is_work_) {
+                        root_is_work_ = true;
+                        open_work();
+                    }
+                    stack_[depth_ - 1] = WORK;
+                    key_ = work_key(k);
+                }
+                break;
+            case WORK:
+                key_ = work_key(k);
+                break;
+            case CONCEPT:
+                if (k == "id") key_ = ID;
+                else if (k == "score") key_ = SCORE;
+                break;
+            case META:
+                if (k == "next_cursor") key_ = NEXT_CURSOR;
+                else if (k == "count") key_ = COUNT;
+                break;
+            default:
+                break;
+        }
+        return true;
+    }
+
+    bool parse_error(size_t, const std::string&, const nlohmann::detail::exception&) override {
+        return false;
+    }
+
+private:
+    enum Context : uint8_t { NONE, ROOT, META, RESULTS, WORK, REFS, CONCEPTS, CONCEPT, SKIP };
+    enum Key : uint8_t { OTHER, ID, YEAR, REFS_KEY, CONCEPTS_KEY, TITLE, SCORE, RESULTS_KEY, META_KEY, NEXT_CURSOR, COUNT };
+
+    static bool is_work_key(const string_t& k) { return work_key(k) != OTHER; }
+    static Key work_key(const string_t& k) {
+        if (k == "id") return ID;
+        if (k == "publication_year") return YEAR;
+        if (k == "referenced_works") return REFS_KEY;
+        if (k == "concepts") return CONCEPTS_KEY;
+        if (k == "title") return TITLE;
+        return OTHER;
+    }
+
+    bool number(double v) {
+        if (top() == WORK && key_ == YEAR) set_year(static_cast<int32_t>(v));
+        else if (top() == CONCEPT && key_ == SCORE) batch_.concepts.back().score = static_cast<float>(v);
+        else if (top() == META && key_ == COUNT && count_) *count_ = static_cast<size_t>(v);
+        return true;
+    }
+
+    WorkBatch::Work& work() { return batch_.works.back(); }
+    void set_year(int32_t year) {
+        work().year = year;
+        work().fields |= WorkRecord::YEAR;
+    }
+    void set_title(const string_t& title) {
+        work().title_begin = static_cast<uint32_t>(batch_.titles.size());
+        batch_.titles += title;
+        work().title_end = static_cast<uint32_t>(batch_.titles.size());
+        work().fields |= WorkRecord::TITLE;
+    }
+    void open_work() {
+        WorkBatch::Work w;
+        w.refs_begin = w.refs_end = static_cast<uint32_t>(batch_.refs.size());
+        w.concepts_begin = w.concepts_end = static_cast<uint32_t>(batch_.concepts.size());
+        w.title_begin = w.title_end = static_cast<uint32_t>(batch_.titles.size());
+        batch_.works.push_back(w);
+    }
+    void close_work() {
+        work().refs_end = static_cast<uint32_t>(batch_.refs.size());
+        work().concepts_end = static_cast<uint32_t>(batch_.concepts.size());
+    }
+
+    // containers deeper than we care about all count as SKIP, so only their number is tracked
+    Context top() const { return depth_ == 0 ? NONE : stack_[min(depth_, max_depth) - 1]; }
+    void push(Context c) {
+        if (depth_ < max_depth) stack_[depth_] = (top() == SKIP) ? SKIP : c;
+        depth_++;
+    }
+    void pop() { depth_--; }
+
+    static const size_t max_depth = 16;
+    WorkBatch&   batch_;
+    std::string* next_cursor_;
+    size_t*      count_;
+    Context      stack_[max_depth] = {};
+    size_t       depth_ = 0;
+    Key          key_ = OTHER;
+    bool         root_is_work_ = false;
+};
+
+} // namespace
+
+bool decode_works(const string& body, WorkBatch& batch, string* next_cursor, size_t* count) {
+    if (next_cursor) next_cursor->clear();
+    if (count) *count = 0;
+    // works are added as they open, so a body cut short would leave the last one half read; on failure the batch
+    // is put back as it was, so nothing from a bad body is ever cached
+    const size_t works = batch.works.size(), refs = batch.refs.size();
+    const size_t concepts = batch.concepts.size(), titles = batch.titles.size();
+    WorkSax sax(batch, next_cursor, count);
+    if (json::sax_parse(body, &sax)) return true;
+    batch.works.resize(works);
+    batch.refs.resize(refs);
+    batch.concepts.resize(concepts);
+    batch.titles.resize(titles);
+    if (next_cursor) next_cursor->clear();
+    return false;
+}
@@ -0,0 +1,42 @@
+#ifndef WORKDECODER_H
+#define WORKDECODER_H
+
+#include <span>
+#include "WorkRecord.h"
+
+using namespace std;
+
+// works of one or more responses decoded into shared flat arrays, so a 100-work page costs a handful of
+// allocations instead of a json DOM node per value
+struct WorkBatch {
+    // one work; the ranges index into the batch's arrays
+    struct Work {
+        WorkId   id;
+        int32_t  year = 0;
+        uint32_t fields = 0; // WorkRecord::Field bits
+        uint32_t refs_begin = 0, refs_end = 0;
+        uint32_t concepts_begin = 0, concepts_end = 0;
+        uint32_t title_begin = 0, title_end = 0;
+    };
+
+    vector<Work>        works;
+    vector<WorkId>      refs;
+    vector<WorkConcept> concepts;
+    string              titles;
+
+    span<const WorkId>      refs_of(const Work& w)     const { return {refs.data() + w.refs_begin, refs.data() + w.refs_end}; }
+    span<const WorkConcept> concepts_of(const Work& w) const { return {concepts.data() + w.concepts_begin, concepts.data() + w.concepts_end}; }
+    string_view             title_of(const Work& w)    const { return string_view(titles).substr(w.title_begin, w.title_end - w.title_begin); }
+    // standalone copy of one work, e.g. for the caches
+    WorkRecord              record(const Work& w)      const;
+};
+
+// decodes a response body straight from the text with nlohmann's SAX interface and appends its works to batch
+// accepts both list responses ({"meta": ..., "results": [...]}) and single work objects
+// only id, publication_year, referenced_works, concepts (id, score) and title are kept; everything else is skipped
+// next_cursor (if given) receives meta.next_cursor, or "" if there is none, and count (if given) meta.count, the
+// number of results on all pages, or 0; returns false if the body is not valid json (e.g. cut short), leaving
+// batch as it was
+bool decode_works(const string& body, WorkBatch& batch, string* next_cursor = nullptr, size_t* count = nullptr);
+
+#endif //WORKDECODER_H
@@ -0,0 +1,110 @@
+#include "WorkRecord.h"
+#include <cctype>
+#include <mutex>
+#include <unordered_map>
+
+uint64_t openalex_num(const string& id) {
+    size_t pos = id.find_last_of('/');
+    pos = (pos == string::npos) ? 0 : pos + 1;
+    // one entity letter followed by digits only
+    if (id.size() < pos + 2 || !isalpha(static_cast<unsigned char>(id[pos]))) return 0;
+    uint64_t num = 0;
+    for (size_t i = pos + 1; i < id.size(); i++) {
+        if (!isdigit(static_cast<unsigned char>(id[i])) || num > (UINT64_MAX - 9) / 10) return 0;
+        num = num * 10 + (id[i] - '0');
+    }
+    return num;
+}
+
+string openalex_url(const uint64_t num, const char prefix) {
+    return string("https://openalex.org/") + prefix + to_string(num);
+}
+
+// side table for IDs that are not plain W-numbers
+static mutex                        interned_mutex;
+static vector<string>               interned_ids;
+static unordered_map<string,size_t> interned_index;
+static const uint64_t               interned_bit = 1ull << 63;
+
+WorkId WorkId::parse(const string& id) {
+    // only a bare W-number or one under the OpenAlex prefix; a DOI such as 10.1234/w5678 is not work W5678
+    static const string prefix = "https://openalex.org/";
+    const size_t pos = id.starts_with(prefix) ? prefix.size() : 0;
+    if (pos >= id.size() || (id[pos] != 'W' && id[pos] != 'w') || id.find('/', pos) != string::npos) return WorkId();
+    const uint64_t num = openalex_num(id);
+    return (num & interned_bit) ? WorkId() : WorkId(num);
+}
+
+WorkId WorkId::from_string(const string& id) {
+    if (WorkId parsed = parse(id)) return parsed;
+    lock_guard<mutex> lock(interned_mutex);
+    auto [it, inserted] = interned_index.emplace(id, interned_ids.size());
+    if (inserted) interned_ids.push_back(id);
+    return WorkId(interned_bit | it->second);
+}
+
+string WorkId::to_string() const {
+    if (!is_interned()) return openalex_url(value);
+    lock_guard<mutex> lock(interned_mutex);
+    return interned_ids[value & ~interned_bit];
+}
+
+string WorkId::filter_string() const {
+    return is_interned() ? to_string() : "W" + std::to_string(value);
+}
+
+void WorkRecord::merge(const WorkRecord& other) {
+    if (other.has(YEAR)) year = other.year;
+    if (other.has(REFS)) refs = other.refs;
+    if (other.has(CONCEPTS)) concepts = other.concepts;
+    if (other.has(TITLE)) title = other.title;
+    fields |= other.fields;
+}
+
+WorkRecord WorkRecord::from_json(const json& work) {
+    WorkRecord rec;
+    if (work.contains("id") && work["id"].is_string())
+        rec.id = WorkId::from_string(work["id"].get<string>());
+    if (work.contains("publication_year")) {
+        rec.year = work["publication_year"].is_number() ? work["publication_year"].get<int32_t>() : 0;
+        rec.fields |= YEAR;
+    }
+    if (work.contains("referenced_works")) {
+        // only regular IDs are kept in references, interned ones mean nothing after a restart
+        for (const auto& ref : work["referenced_works"]) {
+            if (!ref.is_string()) continue;
+            if (WorkId ref_id = WorkId::parse(ref.get<string>())) rec.refs.push_back(ref_id);
+        }
+        rec.fields |= REFS;
+    }
+    if (work.contains("concepts")) {
+        for (const auto& concept_j : work["concepts"]) {
+            if (!concept_j.contains("id") || !concept_j["id"].is_string()) continue;
+            rec.concepts.push_back({openalex_num(concept_j["id"].get<string>()), concept_j.value("score", 0.0f)});
+        }
+        rec.fields |= CONCEPTS;
+    }
+    if (work.contains("title")) {
+        rec.title = work["title"].is_string() ? work["title"].get<string>() : "<no title>";
+        rec.fields |= TITLE;
+    }
+    return rec;
+}
+
+json WorkRecord::to_json() const {
+    json work;
+    work["id"] = id.to_string();
+    if (has(YEAR)) work["publication_year"] = year;
+    if (has(REFS)) {
+        work["referenced_works"] = json::array();
+        for (WorkId ref : refs)
+            work["referenced_works"].push_back(ref.to_string());
+    }
+    if (has(CONCEPTS)) {
+        work["concepts"] = json::array();
+        for (const auto& c : concepts)
+            work["concepts"].push_back({{"id", openalex_url(c.id, 'C')}, {"score", c.score}});
+    }
+    if (has(TITLE)) work["title"] = title;
+    return work;
+}
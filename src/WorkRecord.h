@@ -0,0 +1,87 @@
+#ifndef WORKRECORD_H
+#define WORKRECORD_H
+
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "json/single_include/nlohmann/json.hpp"
+
+using json = nlohmann::json;
+using namespace std;
+
+// numeric part of an OpenAlex ID, e.g. "https://openalex.org/W2079574144" or "W2079574144" -> 2079574144
+// returns 0 for anything else (DOIs, other external IDs)
+uint64_t openalex_num(const string& id);
+
+// full OpenAlex URL for a numeric ID; prefix is 'W' for works and 'C' for concepts
+string openalex_url(uint64_t num, char prefix = 'W');
+
+// compact work ID used throughout the search state instead of the full URL string
+// regular OpenAlex IDs are stored as their W-number; anything else (DOIs, unusual IDs) is interned in a
+// process-wide side table and gets a value with the top bit set
+// strings are only built again at the HTTP and display boundaries
+struct WorkId {
+    uint64_t value = 0;
+
+    WorkId() = default;
+    explicit constexpr WorkId(uint64_t v) : value(v) {}
+    // regular work ID ("https://openalex.org/W2079574144" or "W2079574144"), or the null ID for anything else
+    static WorkId parse(const string& id);
+    // parses, or interns, an ID string
+    static WorkId from_string(const string& id);
+
+    // full URL for regular IDs, the original text for interned ones
+    string to_string() const;
+    // form accepted by the openalex_id filter: "W2079574144" for regular IDs
+    string filter_string() const;
+    bool   is_interned() const { return value >> 63; }
+    explicit operator bool() const { return value != 0; }
+    auto operator<=>(const WorkId&) const = default;
+};
+
+template <>
+struct std::hash<WorkId> {
+    size_t operator()(const WorkId id) const noexcept {
+        // W-numbers are dense, so mix the bits before they pick a bucket
+        uint64_t x = id.value * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(x ^ (x >> 32));
+    }
+};
+
+// one entry of a work's concepts field
+struct WorkConcept {
+    uint64_t id;
+    float    score;
+};
+
+// the fields of an OpenAlex work that the searches use, decoded out of the json
+// requests with select= only return some fields, so fields records which ones are present
+struct WorkRecord {
+    enum Field : uint32_t {
+        YEAR     = 1,
+        REFS     = 2,
+        CONCEPTS = 4,
+        TITLE    = 8,
+        ALL      = YEAR | REFS | CONCEPTS | TITLE
+    };
+
+    WorkId              id;
+    int32_t             year = 0;
+    uint32_t            fields = 0;
+    vector<WorkId>      refs;
+    vector<WorkConcept> concepts;
+    string              title;
+
+    bool has(uint32_t f) const { return (fields & f) == f; }
+    // copy over the fields present in other
+    void merge(const WorkRecord& other);
+
+    // decode a json work object; only fields present in the object are set
+    static WorkRecord from_json(const json& work);
+    // json work object in OpenAlex layout, with the fields this record has
+    json to_json() const;
+};
+
+#endif //WORKRECORD_H
@@ -0,0 +1,63 @@
+#include "WorkStore.h"
+
+WorkStore::WorkStore(const size_t byte_budget) : budget_(byte_budget) {}
+
+size_t WorkStore::footprint(const WorkRecord& rec) {
+    // record, list node and hash node, plus the heap blocks of the vectors and the title
+    return sizeof(WorkRecord) + sizeof(Entry) + 64
+         + rec.refs.capacity() * sizeof(WorkId)
+         + rec.concepts.capacity() * sizeof(WorkConcept)
+         + (rec.title.size() > 15 ? rec.title.capacity() : 0);
+}
+
+shared_ptr<const WorkRecord> WorkStore::get(const WorkId id) {
+    lock_guard<mutex> lock(mutex_);
+    auto it = entries_.find(id);
+    if (it == entries_.end()) return nullptr;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->rec;
+}
+
+void WorkStore::put(const WorkRecord& rec) {
+    if (!rec.id) return;
+    lock_guard<mutex> lock(mutex_);
+    auto it = entries_.find(rec.id);
+    if (it != entries_.end()) {
+        const Entry& old = *it->second;
+        if (old.rec->has(rec.fields)) { // nothing new
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return;
+        }
+        // records are shared with readers, so merge into a copy
+        auto merged = make_shared<WorkRecord>(*old.rec);
+        merged->merge(rec);
+        bytes_ -= old.bytes;
+        lru_.erase(it->second);
+        entries_.erase(it);
+        const size_t merged_bytes = footprint(*merged);
+        lru_.push_front({rec.id, move(merged), merged_bytes});
+    } else {
+        auto copy = make_shared<WorkRecord>(rec);
+        const size_t copy_bytes = footprint(*copy);
+        lru_.push_front({rec.id, move(copy), copy_bytes});
+    }
+    bytes_ += lru_.front().bytes;
+    entries_[rec.id] = lru_.begin();
+
+    // evict from the cold end, but always keep the record just stored
+    while (bytes_ > budget_ && lru_.size() > 1) {
+        bytes_ -= lru_.back().bytes;
+        entries_.erase(lru_.back().id);
+        lru_.pop_back();
+    }
+}
+
+size_t WorkStore::size() {
+    lock_guard<mutex> lock(mutex_);
+    return entries_.size();
+}
+
+size_t WorkStore::bytes() {
+    lock_guard<mutex> lock(mutex_);
+    return bytes_;
+}
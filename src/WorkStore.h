@@ -0,0 +1,40 @@
+#ifndef WORKSTORE_H
+#define WORKSTORE_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "WorkRecord.h"
+
+using namespace std;
+
+// bounded in-memory store of decoded work records, owned by the application and shared by every search
+// least recently used records are evicted once their estimated footprint passes the byte budget
+// safe to use from several threads
+class WorkStore {
+public:
+    explicit WorkStore(size_t byte_budget);
+
+    // record for id, nullptr if it is not in memory; marks it as recently used
+    shared_ptr<const WorkRecord> get(WorkId id);
+    // stores rec under rec.id, merged into what is already stored for it
+    void   put(const WorkRecord& rec);
+    size_t size();
+    size_t bytes();
+private:
+    struct Entry {
+        WorkId                       id;
+        shared_ptr<const WorkRecord> rec;
+        size_t                       bytes;
+    };
+    static size_t footprint(const WorkRecord& rec);
+
+    size_t                                        budget_;
+    size_t                                        bytes_ = 0;
+    mutex                                         mutex_;
+    list<Entry>                                   lru_; // most recently used first
+    unordered_map<WorkId,list<Entry>::iterator>   entries_;
+};
+
+#endif //WORKSTORE_H
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "BatchSearch.h"
+#include "WorkCache.h"
+#include "WorkStore.h"
+
+using namespace std;
+
+// finds the shortest reference path for every start/target pair in a file, as Main's bfs button would one at a
+// time, with every work fetched once for the whole file (see BatchSearch)
+// each line of the pairs file holds a start and a target ID (W-numbers or DOIs), separated by spaces, tabs or a
+// comma; blank lines and lines starting with # are skipped
+// every result goes out as one JSON line as soon as it is found:
+//   {"pair": <line's index among the pairs>, "start": ..., "target": ..., "hops": 2, "path": [<work IDs>]}
+// with "path": null if there is none within the search's limits, and "error" set if the pair could not be searched
+//
+// usage: Batch [-o <results.jsonl>] [-j <connections>] [-c <cache path>] [-n <starts in flight>] <pairs file>
+// works are read from and added to the cache of Main; OPENALEX_OFFLINE and OPENALEX_MAILTO apply as there
+
+// in the working directory by default
+static const char* default_output = "results.jsonl";
+// the cache path of Main
+static const char* default_cache = "openalex_cache";
+// memory budget for decoded works
+static const size_t store_budget = 256 << 20;
+
+// the pairs of a pairs file; false if it cannot be read
+static bool read_pairs(const string& path, vector<PairQuery>& pairs) {
+    ifstream in(path);
+    if (!in) return false;
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        replace(line.begin(), line.end(), ',', ' ');
+        istringstream fields(line);
+        PairQuery pair;
+        if (fields >> pair.start >> pair.target) pairs.push_back(move(pair));
+        else cout << "Skipping line: " << line << endl;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    string output = default_output;
+    string cache_path = default_cache;
+    size_t connections = 8;
+    size_t in_flight = 256;
+    string input;
+    for (int i = 1; i < argc; i++) {
+        const string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "-j" && i + 1 < argc) {
+            connections = max(1, atoi(argv[++i]));
+        } else if (arg == "-c" && i + 1 < argc) {
+            cache_path = argv[++i];
+        } else if (arg == "-n" && i + 1 < argc) {
+            in_flight = max(1, atoi(argv[++i]));
+        } else {
+            input = arg;
+        }
+    }
+    if (input.empty()) {
+        cout << "usage: " << argv[0] << " [-o <results.jsonl>] [-j <connections>] [-c <cache path>] [-n <starts in flight>] <pairs file>" << endl;
+        return 1;
+    }
+    vector<PairQuery> pairs;
+    if (!read_pairs(input, pairs)) {
+        cout << "Could not read " << input << endl;
+        return 1;
+    }
+    ofstream out(output);
+    if (!out) {
+        cout << "Could not write " << output << endl;
+        return 1;
+    }
+
+    ClientPool pool("api.openalex.org", 443, connections);
+    if (const char* mailto = getenv("OPENALEX_MAILTO"))
+        request_scheduler().set_mailto(mailto);
+    if (const char* offline = getenv("OPENALEX_OFFLINE"))
+        set_offline(string(offline) != "0");
+    WorkCache cache(cache_path);
+    set_work_cache(&cache);
+    WorkStore store(store_budget);
+    set_work_store(&store);
+
+    auto start_time = chrono::high_resolution_clock::now();
+    size_t found = 0;
+    BatchSearch search(pool, in_flight);
+    search.run(pairs, [&](const PairResult& result) {
+        json line = {{"pair", result.index}, {"start", result.start}, {"target", result.target}};
+        if (!result.error.empty()) {
+            line["error"] = result.error;
+        } else if (result.path.empty()) {
+            line["path"] = nullptr;
+        } else {
+            json path = json::array();
+            for (const WorkId id : result.path) path.push_back(id.to_string());
+            line["hops"] = result.path.size() - 1;
+            line["path"] = move(path);
+            found++;
+        }
+        // flushed line by line, so results can be read while the batch runs
+        out << line.dump() << endl;
+    });
+
+    auto end_time = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::seconds>(end_time - start_time);
+    cout << "Found paths for " << found << " of " << pairs.size() << " pairs, fetching " << search.fetched()
+         << " works, in " << duration.count() << " s; results in " << output << endl;
+    return 0;
+}
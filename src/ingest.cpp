@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <zlib.h>
+#include "GraphOverlay.h"
+#include "WorkCache.h"
+#include "WorkDecoder.h"
+
+using namespace std;
+
+// builds the local citation graph from the OpenAlex works snapshot
+// (https://docs.openalex.org/download-all-data/snapshot-data-format): every data/works/updated_date=*/part_*.gz
+// partition is streamed line by line and each work's id, publication_year, referenced_works, concepts and title
+// go into a work cache, from which the memory-mapped citation graph <cache path>.<generation>.kpg is then built
+// Main searches the graph with its local graph button, and reads titles from the cache with OPENALEX_OFFLINE set
+//
+// partitions are decompressed and parsed on several threads at once, each with its own buffers, and the
+// graph is then built from the cache on the same number of threads
+//
+// usage: Ingest [-o <cache path>] [-j <threads>] [--compress] [--update] <snapshot directory or .gz partition>...
+// --compress stores the graph's edge lists group varint encoded, for graphs that would not fit in memory otherwise
+// --update adds the partitions of a newer snapshot (updated_date=* folders since the last ingest) without rebuilding
+// the graph: the works go into the cache and the delta log, which Main lays over the graph and folds in later
+// -j defaults to the number of hardware threads
+
+// the default cache path of Main
+static const char* default_output = "openalex_cache";
+// works decoded before they are written out together
+static const size_t batch_works = 10000;
+// zlib reads are buffered this many bytes at a time
+static const size_t read_chunk = 1 << 20;
+
+// collects every .gz partition under path (or path itself), in a stable order
+static void find_partitions(const filesystem::path& path, vector<filesystem::path>& partitions) {
+    if (filesystem::is_directory(path)) {
+        vector<filesystem::path> found;
+        for (const auto& entry : filesystem::recursive_directory_iterator(path)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".gz") found.push_back(entry.path());
+        }
+        sort(found.begin(), found.end());
+        partitions.insert(partitions.end(), found.begin(), found.end());
+    } else {
+        partitions.push_back(path);
+    }
+}
+
+// delta log shared by the workers of an --update
+struct DeltaWriter {
+    string path;
+    mutex  append_mutex;
+    bool   ok = true;
+};
+
+// the records go to the worker's own cache writer; snapshot records are the newest there are, so they replace cached ones
+static void write_batch(WorkCache::Writer& cache, WorkBatch& batch, DeltaWriter* delta) {
+    vector<WorkRecord> records;
+    records.reserve(batch.works.size());
+    for (const auto& work : batch.works) {
+        records.push_back(batch.record(work));
+    }
+    cache.add(records);
+    if (delta) {
+        lock_guard<mutex> lock(delta->append_mutex);
+        delta->ok = append_delta(delta->path, records) && delta->ok;
+    }
+    batch = WorkBatch();
+}
+
+// streams one gzipped JSON Lines partition into cache; returns the number of works read, or -1 if it cannot be opened
+// lines that are not valid json (e.g. a partition cut short) are skipped and counted in skipped
+static long long ingest_partition(const filesystem::path& path, WorkCache::Writer& cache, DeltaWriter* delta, long long& skipped) {
+    gzFile in = gzopen(path.string().c_str(), "rb");
+    if (!in) return -1;
+    gzbuffer(in, read_chunk);
+
+    long long works = 0;
+    WorkBatch batch;
+    string buffer(read_chunk, '\0');
+    string line;
+    // a line that fails to decode leaves nothing in the batch
+    auto decode_line = [&] {
+        if (line.empty()) return;
+        if (decode_works(line, batch)) works++;
+        else skipped++;
+    };
+    int n;
+    while ((n = gzread(in, buffer.data(), static_cast<unsigned>(buffer.size()))) > 0) {
+        // split into lines; a line cut off at the end of the chunk is finished by the next one
+        size_t begin = 0;
+        for (size_t end; (end = buffer.find('\n', begin)) < static_cast<size_t>(n); begin = end + 1) {
+            line.append(buffer, begin, end - begin);
+            decode_line();
+            line.clear();
+        }
+        line.append(buffer, begin, n - begin);
+        if (batch.works.size() >= batch_works) write_batch(cache, batch, delta);
+    }
+    decode_line();
+    write_batch(cache, batch, delta);
+
+    int error;
+    const char* message = gzerror(in, &error);
+    if (error != Z_OK && error != Z_STREAM_END) cout << "Error reading " << path.string() << ": " << message << endl;
+    gzclose(in);
+    return works;
+}
+
+int main(int argc, char* argv[]) {
+    string output = default_output;
+    bool compress = false;
+    bool update = false;
+    size_t threads = max(1u, thread::hardware_concurrency());
+    vector<filesystem::path> partitions;
+    for (int i = 1; i < argc; i++) {
+        const string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "-j" && i + 1 < argc) {
+            threads = max(1, atoi(argv[++i]));
+        } else if (arg == "--compress") {
+            compress = true;
+        } else if (arg == "--update") {
+            update = true;
+        } else {
+            find_partitions(arg, partitions);
+        }
+    }
+    if (partitions.empty()) {
+        cout << "usage: " << argv[0] << " [-o <cache path>] [-j <threads>] [--compress] [--update] <snapshot directory or .gz partition>..." << endl;
+        return 1;
+    }
+
+    auto start_time = chrono::high_resolution_clock::now();
+    // an update needs a graph to lay the delta over
+    DeltaWriter delta{output};
+    if (update) {
+        LocalGraph base(output);
+        if (base.is_open()) {
+            // start the log over if the graph already holds all of it
+            reset_delta(output, base.delta_mark());
+        } else {
+            cout << "No graph at " << output << " to update; building one" << endl;
+            update = false;
+        }
+    }
+    WorkCache cache(output);
+    atomic<long long> total = 0;
+    atomic<size_t> next_partition = 0;
+    atomic<size_t> finished = 0;
+    mutex print_mutex;
+    // each worker claims partitions until none are left; its records are indexed together with all others' once
+    // the workers are done
+    auto worker = [&] {
+        WorkCache::Writer writer(cache);
+        for (size_t i = next_partition++; i < partitions.size(); i = next_partition++) {
+            long long skipped = 0;
+            const long long works = ingest_partition(partitions[i], writer, update ? &delta : nullptr, skipped);
+            if (works > 0) total += works;
+
+            lock_guard<mutex> lock(print_mutex);
+            if (works < 0) cout << "Could not open " << partitions[i].string() << endl;
+            else cout << "(" << ++finished << "/" << partitions.size() << ") " << partitions[i].string() << ": "
+                      << works << " works" << (skipped ? ", " + to_string(skipped) + " malformed lines skipped" : "") << endl;
+        }
+    };
+    vector<thread> workers;
+    for (size_t t = 1; t < min(threads, partitions.size()); t++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : workers) {
+        t.join();
+    }
+
+    if (update) {
+        cache.flush();
+        auto end_time = chrono::high_resolution_clock::now();
+        auto duration = chrono::duration_cast<chrono::seconds>(end_time - start_time);
+        if (!delta.ok) {
+            cout << "Could not write " << output << ".kpd" << endl;
+            return 1;
+        }
+        cout << "Added " << total.load() << " changed works to " << output << ".kpd in " << duration.count() << " s" << endl;
+        return 0;
+    }
+
+    cout << "Building citation graph..." << endl;
+    if (!LocalGraph::build(output, cache, compress, threads)) {
+        cout << "Could not write " << LocalGraph::file_name(output, LocalGraph::latest_generation(output) + 1) << endl;
+        return 1;
+    }
+    LocalGraph graph(output);
+    // the new graph has every cached work, so neither older graphs nor anything logged before it are needed
+    LocalGraph::remove_generations(output, graph.generation());
+    filesystem::remove(output + ".kpd");
+
+    auto end_time = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::seconds>(end_time - start_time);
+    cout << "Ingested " << total.load() << " works into " << output << ".dat/.idx, graph of " << graph.node_count()
+         << " works and " << graph.edge_count() << " references in " << LocalGraph::file_name(output, graph.generation()) << ", in " << duration.count() << " s" << endl;
+    return 0;
+}
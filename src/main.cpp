@@ -1,9 +1,11 @@
 #include <iostream>
 #define CPPHTTPLIB_OPENSSL_SUPPORT
+#define CPPHTTPLIB_ZLIB_SUPPORT
 #include "cpp-httplib/httplib.h"
 #include "json/single_include/nlohmann/json.hpp"
 #include "openalex.h"
 #include "Graph.h"
+#include "LiveGraph.h"
 #include "imgui.h"
 #include "backends/imgui_impl_glfw.h"
 #include "backends/imgui_impl_opengl3.h"
@@ -109,13 +111,63 @@ void drawShortestPath(Graph graph) {
         }
         ImGui::EndTable();
     }
+
+    // with several paths, list each one as its chain of node numbers
+    if (graph.paths().size() > 1) {
+        ImGui::Spacing();
+        if (ImGui::BeginTable("Paths", 3, flags)) {
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::Text("Path:");
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("Hops:");
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("Nodes:");
+            for (size_t i = 0; i < graph.paths().size(); i++) {
+                const auto& path = graph.paths()[i];
+                std::string chain;
+                for (size_t j = 0; j < path.size(); j++) {
+                    chain += (j ? " -> " : "") + std::to_string(path[j]);
+                }
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%d", static_cast<int>(i + 1));
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%d", static_cast<int>(path.size() - 1));
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%s", chain.c_str());
+            }
+            ImGui::EndTable();
+        }
+    }
     ImGui::EndChild();
 }
 
 
+// number of concurrent connections used to fetch a BFS frontier
+static const size_t pool_width = 8;
+// work records fetched in earlier sessions are kept in openalex_cache.dat/.idx
+static const char* cache_path = "openalex_cache";
+// memory budget for decoded works kept between searches
+static const size_t store_budget = 256 << 20;
+// works changed by Ingest --update are folded into the local graph in the background once there are this many
+static const size_t delta_compact_works = 1'000'000;
+
 int main() {
-    httplib::SSLClient cli("api.openalex.org",443);
-    cli.enable_server_certificate_verification(true);
+    ClientPool pool("api.openalex.org", 443, pool_width);
+    httplib::SSLClient& cli = pool[0];
+    // requests carrying a contact address are served from OpenAlex's polite pool
+    if (const char* mailto = getenv("OPENALEX_MAILTO"))
+        request_scheduler().set_mailto(mailto);
+    // search only the graph built by Ingest, without going to the network
+    if (const char* offline = getenv("OPENALEX_OFFLINE"))
+        set_offline(string(offline) != "0");
+    WorkCache cache(cache_path);
+    set_work_cache(&cache);
+    WorkStore store(store_budget);
+    set_work_store(&store);
+    // citation graph built by Ingest, if there is one, with its updates; only mapped, so this is instant
+    LiveGraph local(cache_path, delta_compact_works, thread::hardware_concurrency());
 
     Graph paperGraph;
 
@@ -155,7 +207,28 @@ int main() {
     bool showWindow = true;
     static char paper1[128] = "";
     static char paper2[128] = "";
-    int count = 0;
+    static int  path_count = 5;
+
+    // every search button starts over with an empty graph, runs its search into it and logs what came of it
+    auto search_button = [&](const char* label, const char* running, const function<void(Graph&)>& search,
+                             const function<string(Graph&)>& found) {
+        if (!ImGui::Button(label)) return;
+        paperGraph = Graph();
+        log_messages.emplace_back(running);
+        search(paperGraph);
+        // if there are nodes in the graph, say what was found; if not, there is no connection
+        log_messages.emplace_back(paperGraph.get_size() != 0 ? found(paperGraph) : string("No connection found."));
+    };
+    auto path_found = [](Graph& g) { return "Shortest path found with size: " + to_string(g.get_size()); };
+    auto paths_found = [](Graph& g) { return "Paths found: " + to_string(g.paths().size()); };
+    auto paths_counted = [](Graph& g) { return "Shortest paths: " + g.path_count().to_string(); };
+    // the local graph with its latest updates; a search keeps its snapshot even if a compaction finishes meanwhile
+    auto local_snapshot = [&] {
+        local.refresh();
+        shared_ptr<const GraphOverlay> graph = local.snapshot();
+        if (graph->node_count() == 0) log_messages.emplace_back("No local graph; build one with Ingest.");
+        return graph;
+    };
 
     // the main loop
     while (!glfwWindowShouldClose(window)) {
@@ -196,47 +269,43 @@ int main() {
                     ImGui::InputText("Paper 2", paper2, IM_ARRAYSIZE(paper2));
                     ImGui::Spacing();
 
-                    // button to find the shortest path via befs and update the visualization
-                    if (ImGui::Button("Find Shortest Path - befs")) {
-                        count = count + 1;
-                        if (count > 0) {
-                            paperGraph = Graph();
-                        }
-                        log_messages.emplace_back(std::string("Finding path..."));
-                        paperGraph.graph_by_befs(cli, paper1, paper2);
-
-                        // if there are nodes in the graph, output the size
-                        if (paperGraph.get_size() != 0) {
-                            log_messages.emplace_back(
-                                std::string("Shortest path found with size: ") + std::to_string(paperGraph.get_size())
-                            );
-                        }
-                        // if no nodes, output no connection
-                        else {
-                            log_messages.emplace_back(std::string("No connection found."));
-                        }
-                    }
+                    // buttons for one shortest path, through the api or the local graph
+                    search_button("Find Shortest Path - befs", "Finding path...",
+                                  [&](Graph& g) { g.graph_by_befs(cli, paper1, paper2); }, path_found);
                     ImGui::Spacing();
-                    // button for bfs path
-                    if (ImGui::Button("Find Shortest Path - bfs")) {
-                        count = count + 1;
-                        if (count > 0) {
-                            paperGraph = Graph();
-                        }
-                        log_messages.emplace_back(std::string("Finding path..."));
-                        paperGraph.graph_by_bfs(cli, paper1, paper2);
-
-                        // if there are nodes in the graph, output the size
-                        if (paperGraph.get_size() != 0) {
-                            log_messages.emplace_back(
-                                std::string("Shortest path found with size: ") + std::to_string(paperGraph.get_size())
-                            );
-                        }
-                        // if no nodes, output no connection
-                        else {
-                            log_messages.emplace_back(std::string("No connection found."));
-                        }
-                    }
+                    search_button("Find Shortest Path - bfs", "Finding path...",
+                                  [&](Graph& g) { g.graph_by_bfs(pool, paper1, paper2); }, path_found);
+                    ImGui::Spacing();
+                    search_button("Find Shortest Path - pipelined bfs", "Finding path...",
+                                  [&](Graph& g) { g.graph_by_bfs_levels(pool, paper1, paper2); }, path_found);
+                    ImGui::Spacing();
+                    search_button("Find Shortest Path - bidirectional bfs", "Finding path...",
+                                  [&](Graph& g) { g.graph_by_bidirectional(pool, paper1, paper2); }, path_found);
+                    ImGui::Spacing();
+                    // a*, ranked by publication year
+                    search_button("Find Shortest Path - a*", "Finding path...",
+                                  [&](Graph& g) { g.graph_by_astar(pool, paper1, paper2); }, path_found);
+                    ImGui::Spacing();
+                    search_button("Find Shortest Path - local graph", "Finding path...", [&](Graph& g) {
+                        g.graph_by_local_bfs(*local_snapshot(), cli, paper1, paper2, thread::hardware_concurrency());
+                    }, path_found);
+                    ImGui::Spacing();
+                    // buttons for several alternative paths
+                    ImGui::InputInt("Paths", &path_count);
+                    path_count = std::max(path_count, 1);
+                    search_button("Find Shortest Paths - bfs", "Finding paths...",
+                                  [&](Graph& g) { g.graph_by_k_paths(pool, paper1, paper2, path_count); }, paths_found);
+                    ImGui::SameLine();
+                    search_button("Find Shortest Paths - local graph", "Finding paths...", [&](Graph& g) {
+                        g.graph_by_local_k_paths(*local_snapshot(), cli, paper1, paper2, path_count);
+                    }, paths_found);
+                    // buttons for every shortest path at once, counted, with the first few shown
+                    search_button("Count Shortest Paths - bfs", "Counting paths...",
+                                  [&](Graph& g) { g.graph_by_path_dag(pool, paper1, paper2, path_count); }, paths_counted);
+                    ImGui::SameLine();
+                    search_button("Count Shortest Paths - local graph", "Counting paths...", [&](Graph& g) {
+                        g.graph_by_local_path_dag(*local_snapshot(), cli, paper1, paper2, path_count);
+                    }, paths_counted);
 
                     // this is all for the output log
                     ImGui::Separator();
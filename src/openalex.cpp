@@ -1,12 +1,137 @@
 #include "openalex.h"
 
+static WorkCache* work_cache = nullptr;
+static WorkStore* work_store = nullptr;
+static bool       offline = false;
+
+void set_work_cache(WorkCache* cache) {
+    work_cache = cache;
+}
+
+void set_work_store(WorkStore* store) {
+    work_store = store;
+}
+
+void set_offline(const bool is_offline) {
+    offline = is_offline;
+}
+
+// record for id if it is known with all of the wanted fields, checking memory before disk; nullptr otherwise
+static shared_ptr<const WorkRecord> cached_work(const WorkId id, const uint32_t fields) {
+    if (!id) return nullptr;
+    shared_ptr<const WorkRecord> rec = work_store ? work_store->get(id) : nullptr;
+    if (rec && rec->has(fields)) return rec;
+
+    auto from_disk = make_shared<WorkRecord>();
+    if (!work_cache || !work_cache->get(id, *from_disk)) return nullptr;
+    if (work_store) work_store->put(*from_disk);
+    if (!from_disk->has(fields)) return nullptr;
+    return from_disk;
+}
+
+static void cache_work(const WorkRecord& rec) {
+    if (work_store) work_store->put(rec);
+    if (work_cache) work_cache->put(rec);
+}
+
+// OpenAlex accepts at most 100 OR-ed values in one filter and returns at most 200 results per page
+static const size_t max_filter_ids = 100;
+static const size_t max_per_page   = 200;
+// kept well below common URL limits; leaves room for the per-page and cursor parameters
+static const size_t max_url_length = 4000;
+static const size_t paging_length  = 300;
+
+vector<vector<WorkId>> plan_batches(const vector<WorkId>& ids, const size_t reserved_length) {
+    const size_t fixed_length = string("/works?filter=openalex_id:").size() + reserved_length + paging_length;
+    vector<vector<WorkId>> batches;
+    size_t length = 0;
+    for (const WorkId id : ids) {
+        const size_t id_length = id.filter_string().size() + 1;
+        if (batches.empty() || batches.back().size() == max_filter_ids || length + id_length > max_url_length) {
+            batches.emplace_back();
+            length = fixed_length;
+        }
+        batches.back().push_back(id);
+        length += id_length;
+    }
+    return batches;
+}
+
+// request for the works in batch, with per-page matching the batch so one page holds them all
+static string filter_request(const vector<WorkId>& batch, const string& select) {
+    string request_str = "/works?filter=openalex_id:";
+    for (const WorkId v : batch) {
+        request_str += v.filter_string() + "|";
+    }
+    request_str.erase(request_str.length() - 1);
+    request_str += "&per-page=" + to_string(min(max(batch.size(), size_t(1)), max_per_page));
+    if (!select.empty()) request_str += "&select=" + select;
+    return request_str;
+}
+
+// GETs request_str into body; returns false if the request failed
+static bool get_body(httplib::SSLClient& cli, const string& request_str, const Lane lane, string& body) {
+    if (offline) return false;
+    // GET request
+    httplib::Result res = request_scheduler().get(cli, request_str, lane); // GET request from works endpoint
+    if (!res || res->status != 200) { // error message if response comes back unsuccessful or not at all
+        if (res && res->status == 429) std::cout << "Rate Limited! Code: " << std::to_string(res->status) << std::endl;
+        else std::cout << "Request Failed: " << (res ? std::to_string(res->status) : "no response") << std::endl;
+        return false;
+    }
+    body = move(res->body);
+    return true;
+}
+
+// the works of an openalex_id batch decoded into works; false if the request failed or the body could not be decoded
+// a batch is at most max_filter_ids works and per-page matches it, so they all come on the first page: one
+// request, without cursor paging or a second request to learn there is no next page
+static bool get_batch(httplib::SSLClient& cli, const vector<WorkId>& batch, const string& select, const Lane lane,
+                      WorkBatch& works) {
+    string body;
+    return get_body(cli, filter_request(batch, select), lane, body) && decode_works(body, works);
+}
+
+// as above, with the results appended to results as json
+static bool get_batch(httplib::SSLClient& cli, const vector<WorkId>& batch, const string& select, const Lane lane,
+                      json& results) {
+    string body;
+    if (!get_body(cli, filter_request(batch, select), lane, body)) return false;
+    json page = json::parse(body, nullptr, false);
+    if (page.is_discarded()) return false;
+    for (auto& work : page["results"]) {
+        results.push_back(move(work));
+    }
+    return true;
+}
+
+// every page of a list request with per-page set to max_per_page decoded into batch, following cursor pagination
+// stops at the first page that comes back short or once meta.count results have been read, so the last page
+// costs no extra request for an empty one; returns false if a request failed or a page could not be decoded
+static bool get_all_pages(httplib::SSLClient& cli, const string& request_str, const Lane lane, WorkBatch& batch) {
+    string cursor = "*";
+    size_t read = 0;
+    while (true) {
+        string body;
+        if (!get_body(cli, request_str + "&cursor=" + cursor, lane, body)) return false;
+        const size_t before = batch.works.size();
+        size_t count = 0;
+        if (!decode_works(body, batch, &cursor, &count)) return false;
+        const size_t results = batch.works.size() - before;
+        read += results;
+        // the last page has a null next_cursor, or comes back short
+        if (cursor.empty() || results < max_per_page || read >= count) return true;
+    }
+}
+
 json search_works(httplib::SSLClient& cli, const std::string& search_text, int num_results) {
+    if (offline) return {};
     // create request string
     const std::string num_results_str = std::to_string(num_results);
     const std::string request_str = "/works?search=" + search_text + "&page=1&per-page=" + num_results_str;
 
     // GET request
-    auto res = cli.Get(request_str); // GET request from works endpoint
+    auto res = request_scheduler().get(cli, request_str); // GET request from works endpoint
     if (!res || res->status != 200) { // error message if response comes back unsuccessful or not at all
         std::cout << "Request Failed: " << (res ? std::to_string(res->status) : "no response") << std::endl;
         return {};
@@ -19,13 +144,23 @@ json search_works(httplib::SSLClient& cli, const std::string& search_text, int n
 }
 
 json get_work(httplib::SSLClient& cli, const std::string& id) {
+    // complete records can be served from the cache
+    if (auto cached = cached_work(WorkId::parse(id), WorkRecord::ALL))
+        return cached->to_json();
+    // offline, whatever the cache knows is all there is
+    if (offline) {
+        WorkRecord rec;
+        if (work_cache && work_cache->get(WorkId::parse(id), rec)) return rec.to_json();
+        return {};
+    }
+
     // create request string
     std::string request_str = "/works/" + id;
 
     // GET request
     httplib::Result res;
     do {
-        res = cli.Get(request_str); // GET request from works endpoint
+        res = request_scheduler().get(cli, request_str); // GET request from works endpoint
         if (!res || (res->status != 200 && (res->status < 300 || res->status >= 400))) { // error message if response comes back unsuccessful or not at all, and not a redirect
             std::cout << "Request Failed: " << (res ? std::to_string(res->status) : "no response") << std::endl;
             return {};
@@ -36,132 +171,420 @@ json get_work(httplib::SSLClient& cli, const std::string& id) {
 
     // parse response JSON
     json j = json::parse(res->body);
+    cache_work(WorkRecord::from_json(j));
 
     return j;
 }
 
-void get_refs(httplib::SSLClient& cli, unordered_set<string>& not_fetched, unordered_map<string,unordered_set<string>>& fetched_refs, const int year_target) {
+ClientPool::ClientPool(const string& host, const int port, const size_t width) {
+    for (size_t i = 0; i < max<size_t>(width, 1); i++) {
+        auto cli = make_unique<httplib::SSLClient>(host, port);
+        cli->enable_server_certificate_verification(true);
+        cli->set_keep_alive(true); // reuse the TLS connection across batches
+        clients_.push_back(move(cli));
+    }
+}
+
+// fetches one batch of works and collects the references of those not older than the target
+// returned receives the IDs of every work in the response; returns false if the request failed
+static bool get_refs_batch(httplib::SSLClient& cli, const vector<WorkId>& batch, const int year_target,
+                           RefMap& refs, vector<WorkId>& returned, const Lane lane, YearMap* years = nullptr) {
+    // works already in the cache need no request
+    vector<WorkId> to_fetch;
+    for (const WorkId v : batch) {
+        if (auto cached = cached_work(v, WorkRecord::YEAR | WorkRecord::REFS)) {
+            if (cached->year >= year_target) { // only fetch references for works that aren't older than the target
+                refs[v] = cached->refs;
+            }
+            if (years) (*years)[v] = cached->year;
+            returned.push_back(v);
+        } else {
+            to_fetch.push_back(v);
+        }
+    }
+    if (to_fetch.empty()) return true;
+    if (offline) { // not in the snapshot, so nothing to follow
+        returned.insert(returned.end(), to_fetch.begin(), to_fetch.end());
+        return true;
+    }
+
+    // works are decoded with their referenced_works, plus what the caches keep for other searches
+    WorkBatch j;
+    if (!get_batch(cli, to_fetch, "id,publication_year,referenced_works,concepts,title", lane, j)) return false;
+
+    for (const auto& work : j.works) {
+        if (work.year >= year_target) { // only fetch references for works that aren't older than the target
+            auto work_refs = j.refs_of(work);
+            refs[work.id].assign(work_refs.begin(), work_refs.end());
+        }
+        if (years) (*years)[work.id] = work.year;
+        returned.push_back(work.id);
+        cache_work(j.record(work));
+    }
+    // some papers are available through a work/ request and not a works? request
+    // these seem to have old, conflicting IDs associated
+    if (j.works.empty()) {
+        for (const WorkId single_ref : to_fetch) {
+            cout << "Single Fetch!" << endl;
+            json j_single = get_work(cli,single_ref.to_string());
+            if (!j_single.is_null()) {
+                WorkRecord alias = WorkRecord::from_json(j_single);
+                if (alias.year >= year_target) { // only fetch references for works that aren't older than the target
+                    refs[single_ref] = alias.refs;
+                }
+                if (years) (*years)[single_ref] = alias.year;
+                // remember the references under the old ID too, so it is not single fetched again
+                alias.id = single_ref;
+                alias.fields &= WorkRecord::YEAR | WorkRecord::REFS;
+                cache_work(alias);
+            }
+            returned.push_back(single_ref);
+        }
+    }
+    return true;
+}
+
+// runs fetch_batch on every batch, at most pool.size() at a time
+// each worker owns one client and claims batches until none are left
+static void for_each_batch(ClientPool& pool, const vector<vector<WorkId>>& batches,
+                           const function<void(httplib::SSLClient&, const vector<WorkId>&)>& fetch_batch) {
+    const size_t width = min(pool.size(), batches.size());
+    atomic<size_t> next_batch = 0;
+    auto worker = [&](httplib::SSLClient& cli) {
+        for (size_t b = next_batch++; b < batches.size(); b = next_batch++) {
+            fetch_batch(cli, batches[b]);
+        }
+    };
+
+    vector<thread> workers;
+    for (size_t i = 1; i < width; i++) {
+        workers.emplace_back(worker, ref(pool[i]));
+    }
+    worker(pool[0]);
+    for (auto& t : workers) {
+        t.join();
+    }
+}
+
+void get_refs(ClientPool& pool, unordered_set<WorkId>& not_fetched, RefMap& fetched_refs, const int year_target,
+              YearMap* years) {
     while (!not_fetched.empty()) {
-        cout << "Fetching (" << to_string(not_fetched.size()) << "->" << to_string(fetched_refs.size()) << ")" << endl;
-        // create request string
-        string request_str = "/works?filter=openalex_id:";
-        int it = 0;
-        for (const string& v : not_fetched) {
-            request_str += v + "|";
-            if (it == 49) break;
-            it++;
+        // split the frontier into as few batches as the API allows
+        vector<vector<WorkId>> batches = plan_batches(vector<WorkId>(not_fetched.begin(), not_fetched.end()));
+        cout << "Fetching (" << to_string(not_fetched.size()) << "->" << to_string(fetched_refs.size()) << ") on "
+             << min(pool.size(), batches.size()) << " connections" << endl;
+
+        mutex merge_mutex;
+        bool failed = false;
+        for_each_batch(pool, batches, [&](httplib::SSLClient& cli, const vector<WorkId>& batch) {
+            RefMap refs;
+            YearMap batch_years;
+            vector<WorkId> returned;
+            const bool ok = get_refs_batch(cli, batch, year_target, refs, returned, Lane::CRITICAL,
+                                           years ? &batch_years : nullptr);
+
+            lock_guard<mutex> lock(merge_mutex);
+            if (!ok) {
+                failed = true;
+                return;
+            }
+            for (auto& [id, id_refs] : refs) {
+                fetched_refs[id] = move(id_refs);
+            }
+            if (years) years->insert(batch_years.begin(), batch_years.end());
+            for (const WorkId id : returned) {
+                not_fetched.erase(id);
+            }
+        });
+        if (failed) return;
+    }
+}
+
+// request for every work citing one in batch and published no later than year_start
+// a work can cite several of the batch, so pages are filled to the maximum rather than to the batch size
+string cites_request(const vector<WorkId>& batch, const int year_start) {
+    string request_str = "/works?filter=cites:";
+    for (const WorkId v : batch) {
+        request_str += v.filter_string() + "|";
+    }
+    request_str.erase(request_str.length() - 1);
+    request_str += ",to_publication_date:" + to_string(year_start) + "-12-31";
+    request_str += "&per-page=" + to_string(max_per_page);
+    request_str += "&select=id,publication_year,referenced_works";
+    return request_str;
+}
+
+vector<WorkId> get_citers(ClientPool& pool, const vector<WorkId>& cited, RefMap& citers, const int year_start) {
+    vector<WorkId> failed;
+    if (offline) return failed;
+    // the cites filter only takes OpenAlex IDs
+    vector<WorkId> to_fetch;
+    for (const WorkId id : cited) {
+        if (!id.is_interned()) to_fetch.push_back(id);
+    }
+    // room for the publication date filter and the select
+    vector<vector<WorkId>> batches = plan_batches(to_fetch, 80);
+    cout << "Fetching citers (" << to_string(to_fetch.size()) << ") on "
+         << min(pool.size(), batches.size()) << " connections" << endl;
+
+    mutex merge_mutex;
+    for_each_batch(pool, batches, [&](httplib::SSLClient& cli, const vector<WorkId>& batch) {
+        WorkBatch j;
+        const bool ok = get_all_pages(cli, cites_request(batch, year_start), Lane::CRITICAL, j);
+        const unordered_set<WorkId> in_batch(batch.begin(), batch.end());
+
+        lock_guard<mutex> lock(merge_mutex);
+        // the pages that did arrive of a failed request hold only some of the citers, which would pass for all
+        // of them; the works that did arrive are still cached
+        if (!ok) failed.insert(failed.end(), batch.begin(), batch.end());
+        for (const auto& work : j.works) {
+            // the response does not say which of the batch a work cites, so look in its references
+            for (const WorkId ref : j.refs_of(work)) {
+                if (ok && in_batch.contains(ref)) citers[ref].push_back(work.id);
+            }
+            cache_work(j.record(work));
         }
-        request_str.erase(request_str.length() - 1);
+    });
+    return failed;
+}
 
-        // GET request
-        httplib::Result res = cli.Get(request_str); // GET request from works endpoint
-        if (!res || res->status != 200) { // error message if response comes back unsuccessful or not at all
-            if (res && res->status == 429) std::cout << "Rate Limited! Code: " << std::to_string(res->status) << std::endl;
-            else std::cout << "Request Failed: " << (res ? std::to_string(res->status) : "no response") << std::endl;
-            return;
+RefFetcher::RefFetcher(ClientPool& pool, const int year_target) : year_target_(year_target) {
+    for (size_t i = 0; i < pool.size(); i++) {
+        workers_.emplace_back(&RefFetcher::work, this, ref(pool[i]));
+    }
+}
+
+RefFetcher::~RefFetcher() {
+    {
+        lock_guard<mutex> lock(mutex_);
+        stop_ = true;
+        batches_.clear(); // nobody is waiting on queued batches anymore
+    }
+    work_cv_.notify_all();
+    for (auto& t : workers_) {
+        t.join();
+    }
+}
+
+void RefFetcher::request(const WorkId id) {
+    {
+        lock_guard<mutex> lock(mutex_);
+        if (!requested_.insert(id).second) return;
+        pending_.push_back(id);
+        if (pending_.size() < max_filter_ids) return;
+    }
+    flush();
+}
+
+void RefFetcher::flush() {
+    {
+        lock_guard<mutex> lock(mutex_);
+        if (pending_.empty()) return;
+        for (auto& batch : plan_batches(pending_)) {
+            batches_.push_back(move(batch));
         }
+        pending_.clear();
+    }
+    work_cv_.notify_all();
+}
 
-        // parse response JSON into array
-        json j = json::parse(res->body)["results"];
-        // objects in array include id and referenced_works, which itself is an array of openalex_ids
+const vector<WorkId>& RefFetcher::refs(const WorkId id) {
+    request(id);
+    flush();
+    unique_lock<mutex> lock(mutex_);
+    done_cv_.wait(lock, [&] { return done_.contains(id); });
+    return fetched_refs_[id];
+}
 
-        for (size_t i = 0; i < j.size(); i++) {
-            if (j[i].value("publication_year",0) >= year_target) { // only fetch references for works that aren't older than the target
-                for (const auto& ref : j[i]["referenced_works"]) {
-                    fetched_refs[j[i]["id"]].emplace(ref);
-                }
+void RefFetcher::work(httplib::SSLClient& cli) {
+    unique_lock<mutex> lock(mutex_);
+    while (true) {
+        work_cv_.wait(lock, [&] { return stop_ || !batches_.empty(); });
+        if (stop_) return;
+        vector<WorkId> batch = move(batches_.front());
+        batches_.pop_front();
+
+        lock.unlock();
+        RefMap refs;
+        vector<WorkId> returned;
+        // the search only waits on these once it reaches the next level
+        const bool ok = get_refs_batch(cli, batch, year_target_, refs, returned, Lane::PREFETCH);
+        lock.lock();
+
+        if (!ok) {
+            // leave the edges out rather than stall the search, like get_refs does
+            for (const WorkId id : batch) done_.insert(id);
+        } else {
+            for (auto& [id, id_refs] : refs) {
+                fetched_refs_[id] = move(id_refs);
             }
-            not_fetched.erase(j[i]["id"]);
-        }
-        // some papers are available through a work/ request and not a works? request
-        // these seem to have old, conflicting IDs associated
-        if (j.size() == 0 && not_fetched.size() != 0) {
-            for (const string& single_ref : not_fetched) {
-                cout << "Single Fetch!" << endl;
-                json j_single = get_work(cli,single_ref);
-                if (!j_single.is_null() && j_single.value("publication_year",0) >= year_target) { // only fetch references for works that aren't older than the target
-                    for (const auto& ref : j_single["referenced_works"]) {
-                        fetched_refs[single_ref].emplace(ref);
-                    }
-                }
-                not_fetched.erase(single_ref);
+            done_.insert(returned.begin(), returned.end());
+            // works missing from a partial page go out again in their own batch
+            vector<WorkId> missing;
+            for (const WorkId id : batch) {
+                if (!done_.contains(id)) missing.push_back(id);
+            }
+            if (!missing.empty()) {
+                batches_.push_back(move(missing));
+                work_cv_.notify_one();
             }
         }
+        done_cv_.notify_all();
     }
 }
 
+// select with the id field in front if it does not have it; batched results are matched back to ids by it
+static string select_with_id(const string& select) {
+    for (size_t begin = 0; begin <= select.size();) {
+        const size_t end = min(select.find(',', begin), select.size());
+        if (select.compare(begin, end - begin, "id") == 0) return select;
+        begin = end + 1;
+    }
+    return select.empty() ? "id" : "id," + select;
+}
+
+vector<json> get_works(httplib::SSLClient& cli, const vector<WorkId>& ids, const string& select) {
+    // the id is needed to put results back in order
+    const string select_str = select_with_id(select);
+
+    // batch each work once, however often it appears in ids
+    unordered_map<WorkId,json> found;
+    vector<WorkId> to_fetch;
+    unordered_set<WorkId> queued;
+    for (const WorkId id : ids) {
+        if (!id.is_interned() && queued.insert(id).second) to_fetch.push_back(id);
+    }
+
+    for (const auto& batch : plan_batches(to_fetch, select_str.size() + 8)) {
+        json results = json::array();
+        // on failure the works of this batch fall back to single requests below
+        get_batch(cli, batch, select_str, Lane::CRITICAL, results);
+        for (auto& work : results) {
+            cache_work(WorkRecord::from_json(work));
+            found[WorkId::parse(work.value("id", ""))] = move(work);
+        }
+    }
+
+    vector<json> works;
+    works.reserve(ids.size());
+    for (const WorkId id : ids) {
+        auto f = found.find(id);
+        if (f == found.end()) {
+            // merged works only answer at /works/<old id>, which redirects to the current record;
+            // DOIs and other external IDs land here too
+            json work = get_work(cli, id.to_string());
+            if (!work.is_null()) found[id] = work;
+            works.push_back(move(work));
+        } else {
+            works.push_back(f->second);
+        }
+    }
+    return works;
+}
+
 vector<string> get_titles(httplib::SSLClient& cli,
-                          const vector<string>& ids) {
-    vector<string> titles;
-    titles.reserve(ids.size());
-    for (auto &id : ids) {
-        auto w = get_work(cli, id);
-        titles.push_back(w.value("title", "<no title>"));
+                          const vector<WorkId>& ids) {
+    vector<string> titles(ids.size());
+    vector<WorkId> missing;
+    vector<size_t> missing_pos;
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (auto cached = cached_work(ids[i], WorkRecord::TITLE)) {
+            titles[i] = cached->title;
+        } else {
+            missing.push_back(ids[i]);
+            missing_pos.push_back(i);
+        }
+    }
+
+    // resolve the rest in batches
+    vector<json> works = get_works(cli, missing, "id,title");
+    for (size_t k = 0; k < works.size(); k++) {
+        const json& w = works[k];
+        titles[missing_pos[k]] = (w.contains("title") && w["title"].is_string()) ? w["title"].get<string>() : "<no title>";
+        if (w.is_null()) continue;
+        // remember the title under the requested ID, which differs from w["id"] for merged works
+        WorkRecord rec;
+        rec.id = missing[k];
+        rec.title = titles[missing_pos[k]];
+        rec.fields = WorkRecord::TITLE;
+        cache_work(rec);
     }
     return titles;
 }
 
-float get_heuristic(const json& current_concepts, size_t current_num_refs, const unordered_map<string,float>& target_concepts) {
-    float score = 0.0f;
+float get_heuristic(span<const WorkConcept> current_concepts, const unordered_map<uint64_t,float>& target_concepts) {
     float min_sum = 0.0f;
     float max_sum = 0.0f;
-    for (size_t i = 0; i < current_concepts.size(); i++) {
-        auto iter = target_concepts.find(current_concepts[i]["id"]);
+    for (const auto& c : current_concepts) {
+        auto iter = target_concepts.find(c.id);
         if (iter != target_concepts.end()) {
-            min_sum += min(iter->second,current_concepts[i].value("score",0.0f));
-            max_sum += max(iter->second,current_concepts[i].value("score",0.0f));
+            min_sum += min(iter->second, c.score);
+            max_sum += max(iter->second, c.score);
         } else {
-            max_sum += current_concepts[i].value("score", 0.0f); // if many concepts are not shared, will be penalized
+            max_sum += c.score; // if many concepts are not shared, will be penalized
         }
     }
-    score = min_sum/max_sum;
-    return score;
+    return min_sum/max_sum;
 }
 
-vector<pair<float,string>> get_refs_befs(httplib::SSLClient& cli, const string& id, const unordered_map<string,float>& target_concepts, const int year_target) {
-    vector<pair<float,string>> result_refs;
-    // create request string
-    string request_str = "/works/" + id.substr(21) + "?select=referenced_works";
-    // GET request
-    httplib::Result res = cli.Get(request_str); // GET request from works endpoint
-    if (!res || res->status != 200) { // error message if response comes back unsuccessful or not at all
-        if (res && res->status == 429) std::cout << "Rate Limited! Code: " << std::to_string(res->status) << std::endl;
-        else {
-            std::cout << "u Request Failed: " << (res ? std::to_string(res->status) : "no response") << std::endl;
+vector<pair<float,WorkId>> get_refs_befs(httplib::SSLClient& cli, const WorkId id, const unordered_map<uint64_t,float>& target_concepts, const int year_target) {
+    vector<pair<float,WorkId>> result_refs;
+    vector<WorkId> refs;
+    if (auto cached = cached_work(id, WorkRecord::REFS)) {
+        refs = cached->refs;
+    } else if (offline) {
+        return vector<pair<float,WorkId>>();
+    } else {
+        // create request string
+        string request_str = "/works/" + id.filter_string() + "?select=referenced_works";
+        // GET request
+        httplib::Result res = request_scheduler().get(cli, request_str); // GET request from works endpoint
+        if (!res || res->status != 200) { // error message if response comes back unsuccessful or not at all
+            if (res && res->status == 429) std::cout << "Rate Limited! Code: " << std::to_string(res->status) << std::endl;
+            else {
+                std::cout << "u Request Failed: " << (res ? std::to_string(res->status) : "no response") << std::endl;
+            }
+            return vector<pair<float,WorkId>>();
         }
-        return vector<pair<float,string>>();
+        // decode response into its referenced_works
+        WorkBatch u_batch;
+        const bool decoded = decode_works(res->body, u_batch);
+        cout << "u Request" << endl;
+        if (!decoded || u_batch.works.empty()) return vector<pair<float,WorkId>>();
+        WorkRecord u = u_batch.record(u_batch.works[0]);
+        refs = u.refs;
+        u.id = id;
+        cache_work(u);
     }
-    // parse response JSON into array
-    json refs_j = json::parse(res->body)["referenced_works"];
-    cout << "u Request" << endl;
 
-    size_t it = 0;
-    while (it < refs_j.size()) {
-        // create second request string
-        request_str = "/works?filter=openalex_id:";
-        for (int i = 0; i < 50; i++) {
-            if (refs_j[it].is_string())
-                request_str += refs_j[it].get<string>() + "|";
-            it++;
+    // score cached references right away, fetch the rest
+    const uint32_t befs_fields = WorkRecord::YEAR | WorkRecord::REFS | WorkRecord::CONCEPTS;
+    vector<WorkId> to_fetch;
+    for (const WorkId ref : refs) {
+        if (auto cached = cached_work(ref, befs_fields)) {
+            if (cached->year >= year_target) {
+                float work_h = get_heuristic(cached->concepts, target_concepts);
+                result_refs.push_back({work_h, ref});
+            }
+        } else {
+            to_fetch.push_back(ref);
         }
-        request_str.erase(request_str.length()-1);
-        request_str += "&select=id,publication_year,referenced_works,concepts";
+    }
 
-        res = cli.Get(request_str); // GET request from works endpoint
-        cout << "v Request: (" << it << "/" << refs_j.size() << ")" << endl;
-        if (!res || res->status != 200) { // error message if response comes back unsuccessful or not at all
-            if (res && res->status == 429) std::cout << "Rate Limited! Code: " << std::to_string(res->status) << std::endl;
-            else std::cout << "v Request Failed: " << (res ? std::to_string(res->status) : "no response") << std::endl;
-        } else {
-            json j = json::parse(res->body)["results"];
-            for (auto work : j) {
-                if (work.value("publication_year",0) >= year_target) {
-                    size_t work_num_refs = work["referenced_works"].size();
-                    float work_h = get_heuristic(work["concepts"], work_num_refs, target_concepts);
-                    result_refs.push_back({work_h, work["id"]});
-                }
+    const string befs_select = "id,publication_year,referenced_works,concepts";
+    size_t requested = 0;
+    for (const auto& batch : plan_batches(to_fetch, befs_select.size() + 8)) {
+        WorkBatch j;
+        const bool ok = get_batch(cli, batch, befs_select, Lane::CRITICAL, j);
+        requested += batch.size();
+        cout << "v Request: (" << requested << "/" << to_fetch.size() << ")" << (ok ? "" : " failed") << endl;
+        for (const auto& work : j.works) {
+            cache_work(j.record(work));
+            if (work.year >= year_target) {
+                float work_h = get_heuristic(j.concepts_of(work), target_concepts);
+                result_refs.push_back({work_h, work.id});
             }
         }
     }
     return result_refs;
-}
\ No newline at end of file
+}
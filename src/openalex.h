@@ -2,8 +2,18 @@
 #define OPENALEX_H
 
 #define CPPHTTPLIB_OPENSSL_SUPPORT
+#define CPPHTTPLIB_ZLIB_SUPPORT
 #include "cpp-httplib/httplib.h"
 #include "json/single_include/nlohmann/json.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "RequestScheduler.h"
+#include "WorkCache.h"
+#include "WorkDecoder.h"
+#include "WorkStore.h"
 
 using json = nlohmann::json;
 using namespace std;
@@ -12,8 +22,26 @@ using namespace std;
 
 // these helper functions take an httplib::SSLClient as a parameter,
 // so that a new client need not be created for every function call
+// every request goes through request_scheduler(), which paces them and retries rate-limited ones
 // all return either a json work object or a json array of work objects
 
+// persistent cache that the helpers below check before going to the network and fill with what they fetch
+// nullptr (the default) turns caching off
+void set_work_cache(WorkCache* cache);
+
+// in-memory store of decoded records checked before the persistent cache, so that records outlive a single search
+// nullptr (the default) turns it off
+void set_work_store(WorkStore* store);
+
+// offline mode answers everything from the work cache (e.g. one built from the snapshot by Ingest) and never
+// goes to the network; works missing from the cache are treated as unknown, with no references
+// get_citers needs citation edges, which the work cache does not hold, so it finds nothing offline
+void set_offline(bool offline);
+
+// splits ids into batches for filter=openalex_id: requests, packing each one as full as the API allows:
+// at most 100 OR-ed IDs, and a request URL (including reserved_length characters of other parameters) under 4000 characters
+vector<vector<WorkId>> plan_batches(const vector<WorkId>& ids, size_t reserved_length = 0);
+
 // searches for search_text in titles, abstracts, and fulltext, and returns the first num_results results
 json search_works(httplib::SSLClient& cli, const string& search_text, int num_results);
 
@@ -21,18 +49,80 @@ json search_works(httplib::SSLClient& cli, const string& search_text, int num_re
 // DO NOT USE IN IMPLEMENTATION OF FUNCTIONS THAT RETRIEVE MULTIPLE WORKS AT ONCE; IT CALLS THE API ONCE FOR EACH WORK
 json get_work(httplib::SSLClient& cli, const string& id);
 
+// fixed set of keep-alive clients to the same host, so that independent requests can be in flight at once
+// each concurrent worker uses exactly one client (httplib clients are not safe to share between threads)
+class ClientPool {
+public:
+    ClientPool(const string& host, int port, size_t width);
+    size_t size() const { return clients_.size(); }
+    httplib::SSLClient& operator[](size_t i) { return *clients_[i]; }
+private:
+    vector<unique_ptr<httplib::SSLClient>> clients_;
+};
+
+// references of each fetched work: outgoing edges in the citation graph
+using RefMap = unordered_map<WorkId,vector<WorkId>>;
+// publication year of each fetched work
+using YearMap = unordered_map<WorkId,int>;
+
 // gets the ids of works referenced by those in not_fetched and places them in fetched_refs respectively;
 // also clears not_fetched
+// with years given, the publication year of every work found is placed there too (they come in the same response)
+// the batches are sent concurrently, at most pool.size() at a time
 // outgoing edges in citation graph
-void get_refs(httplib::SSLClient& cli, unordered_set<string>& not_fetched, unordered_map<string,unordered_set<string>>& fetched_refs, int year_target);
+void get_refs(ClientPool& pool, unordered_set<WorkId>& not_fetched, RefMap& fetched_refs, int year_target,
+              YearMap* years = nullptr);
+
+// gets the IDs of works citing those in cited, published no later than year_start, and places them in citers respectively
+// uses filter=cites: batches sent concurrently like get_refs; works with no citers get no entry
+// returns the works of batches whose request failed, which get no entry either, as their citers are not all known
+// incoming edges in citation graph
+vector<WorkId> get_citers(ClientPool& pool, const vector<WorkId>& cited, RefMap& citers, int year_start);
+
+// the filter=cites: request get_citers sends for one of its batches, every page but the cursor
+string cites_request(const vector<WorkId>& batch, int year_start);
+
+// background reference fetcher for pipelined searches
+// IDs passed to request() are packed into batches that are fetched on the pool's connections
+// while the caller keeps working; refs() only blocks until the batch holding that ID has come back
+class RefFetcher {
+public:
+    RefFetcher(ClientPool& pool, int year_target);
+    ~RefFetcher();
+    // queue an ID; full batches are sent right away
+    void request(WorkId id);
+    // send the partially filled batch
+    void flush();
+    // references of id (empty if it is older than the target or could not be fetched)
+    const vector<WorkId>& refs(WorkId id);
+private:
+    void work(httplib::SSLClient& cli);
+
+    int                    year_target_;
+    mutex                  mutex_;
+    condition_variable     work_cv_;
+    condition_variable     done_cv_;
+    deque<vector<WorkId>>  batches_;
+    vector<WorkId>         pending_;
+    unordered_set<WorkId>  requested_;
+    unordered_set<WorkId>  done_;
+    RefMap                 fetched_refs_;
+    bool                   stop_ = false;
+    vector<thread>         workers_;
+};
+
+// returns the select fields (comma separated, as in the API's select=) of many works at once, in the order of ids
+// uses filter=openalex_id: batches; works missing from a batch (merged or redirected IDs) are looked up one at a time
+// entries are null for works that could not be found
+vector<json> get_works(httplib::SSLClient& cli, const vector<WorkId>& ids, const string& select);
 
 // fetch titles for a list of IDs
-vector<string> get_titles(httplib::SSLClient& cli, const vector<string>& ids);
+vector<string> get_titles(httplib::SSLClient& cli, const vector<WorkId>& ids);
 
-// heuristic for befs
-float get_heuristic(const json& current_concepts, size_t current_num_refs, const unordered_map<string,float>& target_concepts);
+// heuristic for befs: overlap of a work's concepts with the target's, keyed by numeric concept ID
+float get_heuristic(span<const WorkConcept> current_concepts, const unordered_map<uint64_t,float>& target_concepts);
 
 // get refs with their heuristics for befs
-vector<pair<float,string>> get_refs_befs(httplib::SSLClient& cli, const string& id, const unordered_map<string,float>& target_concepts, const int year_target);
+vector<pair<float,WorkId>> get_refs_befs(httplib::SSLClient& cli, WorkId id, const unordered_map<uint64_t,float>& target_concepts, const int year_target);
 
 #endif //OPENALEX_H
\ No newline at end of file
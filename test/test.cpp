@@ -3,12 +3,52 @@
 #include <sstream>
 #include <string>
 #define CPPHTTPLIB_OPENSSL_SUPPORT
+#define CPPHTTPLIB_ZLIB_SUPPORT
 #include "cpp-httplib/httplib.h"
 #include "json/single_include/nlohmann/json.hpp"
 #include "openalex.h"
+#include "BatchSearch.h"
+#include "FlatMap.h"
+#include "Graph.h"
+#include "GraphBuilder.h"
+#include "LiveGraph.h"
+#include "LocalGraph.h"
+#include "RequestScheduler.h"
+#include "WorkCache.h"
+#include "WorkStore.h"
+#include <filesystem>
+#include <set>
+#include <thread>
 
 using json = nlohmann::json;
 
+// path of a test's cache and graph files in the temporary directory, with any left by an earlier run removed
+static std::string fresh_path(const std::string& name) {
+    const std::string path = (std::filesystem::temp_directory_path() / name).string();
+    for (const char* ext : {".dat", ".idx", ".kpd"})
+        std::filesystem::remove(path + ext);
+    LocalGraph::remove_generations(path, UINT64_MAX);
+    return path;
+}
+
+// a work cache in a fresh file, installed as the API's cache with requests switched off for as long as it lives
+// the destructor puts both back, so a failed REQUIRE cannot leave later tests offline or reading a destroyed cache
+struct OfflineCache {
+    explicit OfflineCache(const std::string& name) : path(fresh_path(name)), cache(path) {
+        set_work_cache(&cache);
+        set_offline(true);
+    }
+    ~OfflineCache() {
+        set_offline(false);
+        set_work_cache(nullptr);
+    }
+    OfflineCache(const OfflineCache&) = delete;
+    OfflineCache& operator=(const OfflineCache&) = delete;
+
+    const std::string path;
+    WorkCache         cache;
+};
+
 TEST_CASE("Search Test", "[tag]") {
     std::string expected = R"(Title: Materials, Actuators, and Sensors for Soft Bioinspired Robots
 DOI: https://doi.org/10.1002/adma.202003139
@@ -56,4 +96,837 @@ ID: https://openalex.org/W2114434484
     }
 
     REQUIRE(expected == oss.str());
-}
\ No newline at end of file
+}
+
+TEST_CASE("Work Cache Test", "[cache]") {
+    const std::string path = fresh_path("knowledge_path_cache_test");
+
+    WorkRecord refs_only;
+    refs_only.id = WorkId(2079574144);
+    refs_only.year = 2013;
+    refs_only.refs = {WorkId(2114434484), WorkId(1967)};
+    refs_only.fields = WorkRecord::YEAR | WorkRecord::REFS;
+
+    WorkRecord titled;
+    titled.id = WorkId(2079574144);
+    titled.title = "Soft robotics: a bioinspired evolution in robotics";
+    titled.concepts = {{41008148, 0.5f}};
+    titled.fields = WorkRecord::TITLE | WorkRecord::CONCEPTS;
+
+    {
+        WorkCache cache(path);
+        cache.put(refs_only);
+        cache.put(titled);
+        WorkRecord rec;
+        REQUIRE(cache.get(WorkId(2079574144), rec));
+        REQUIRE(rec.has(WorkRecord::ALL));
+        REQUIRE_FALSE(cache.get(WorkId(2114434484), rec));
+    }
+
+    // reopened from disk, both puts merged into one record
+    WorkCache cache(path);
+    REQUIRE(cache.size() == 1);
+    WorkRecord rec;
+    REQUIRE(cache.get(WorkId(2079574144), rec));
+    REQUIRE(rec.year == 2013);
+    REQUIRE(rec.refs == refs_only.refs);
+    REQUIRE(rec.title == titled.title);
+    REQUIRE(rec.concepts.size() == 1);
+    REQUIRE(rec.to_json()["concepts"][0]["id"] == "https://openalex.org/C41008148");
+    REQUIRE(openalex_num("https://openalex.org/W2079574144") == 2079574144);
+    REQUIRE(openalex_num("https://doi.org/10.1002/adma.202003139") == 0);
+}
+
+TEST_CASE("Work Cache Recovery Test", "[cache]") {
+    const std::string path = fresh_path("knowledge_path_cache_recovery_test");
+    const std::string tail_path = fresh_path("knowledge_path_cache_recovery_tail");
+    auto record = [](const uint64_t id) {
+        WorkRecord rec;
+        rec.id = WorkId(id); rec.year = 2000; rec.refs = {WorkId(id + 1)};
+        rec.fields = WorkRecord::YEAR | WorkRecord::REFS;
+        return rec;
+    };
+    {
+        WorkCache cache(path);
+        cache.put(record(1));
+    }
+    {
+        WorkCache tail(tail_path);
+        tail.put(record(2));
+    }
+    // records appended after the last flush and a torn one, as a session killed while writing leaves them
+    std::string bytes;
+    {
+        std::ifstream in(tail_path + ".dat", std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    {
+        std::ofstream out(path + ".dat", std::ios::binary | std::ios::app);
+        out.write(bytes.data() + 8, static_cast<std::streamsize>(bytes.size() - 8));
+        out.write(bytes.data() + 8, 12);
+    }
+    {
+        WorkCache cache(path);
+        WorkRecord rec;
+        REQUIRE(cache.pending() == 1);
+        REQUIRE(cache.get(WorkId(2), rec));
+        REQUIRE(rec.refs == std::vector<WorkId>{WorkId(3)});
+        cache.put(record(4));
+    }
+
+    // rebuilt from the records alone: the torn bytes were cut off, so the record put after them reads back
+    std::filesystem::remove(path + ".idx");
+    WorkCache cache(path);
+    REQUIRE(cache.size() == 3);
+    WorkRecord rec;
+    for (const uint64_t id : {1, 2, 4}) {
+        REQUIRE(cache.get(WorkId(id), rec));
+        REQUIRE(rec.refs == std::vector<WorkId>{WorkId(id + 1)});
+    }
+}
+
+TEST_CASE("Work Cache Writer Test", "[cache]") {
+    const std::string path = fresh_path("knowledge_path_cache_writer_test");
+
+    // two bulk writers on their own threads and a plain put, merged into the index by one flush
+    WorkCache cache(path);
+    WorkRecord rec;
+    rec.fields = WorkRecord::YEAR | WorkRecord::REFS;
+    rec.id = WorkId(5); rec.year = 1990;
+    cache.put(rec);
+    auto load = [&](const uint64_t first, const int32_t year) {
+        WorkCache::Writer writer(cache);
+        std::vector<WorkRecord> recs;
+        for (uint64_t id = first; id < first + 100; id++) {
+            WorkRecord r;
+            r.id = WorkId(id); r.year = year; r.refs = {WorkId(id + 1)};
+            r.fields = WorkRecord::YEAR | WorkRecord::REFS;
+            recs.push_back(r);
+        }
+        writer.add(recs);
+        // the later record of a work added twice is kept
+        recs.resize(1);
+        recs[0].year = year + 1;
+        writer.add(recs);
+    };
+    std::thread other(load, 1, 2000);
+    load(1000, 2010);
+    other.join();
+    WorkRecord found;
+    REQUIRE_FALSE(cache.get(WorkId(1000), found));
+    cache.flush();
+
+    REQUIRE(cache.size() == 200);
+    REQUIRE(cache.get(WorkId(1), found));
+    REQUIRE(found.year == 2001);
+    REQUIRE(cache.get(WorkId(2), found));
+    REQUIRE(found.year == 2000);
+    REQUIRE(found.refs == std::vector<WorkId>{WorkId(3)});
+    REQUIRE(cache.get(WorkId(5), found));
+    REQUIRE(found.year == 2000); // replaced the earlier put
+    REQUIRE(cache.get(WorkId(1099), found));
+    REQUIRE(found.year == 2010);
+    REQUIRE_FALSE(std::filesystem::exists(path + ".run0"));
+}
+
+TEST_CASE("Work Store Test", "[store]") {
+    WorkRecord rec;
+    rec.fields = WorkRecord::YEAR | WorkRecord::REFS;
+    rec.refs.assign(100, WorkId(1));
+
+    // room for a handful of records only
+    WorkStore store(8 * 1024);
+    for (uint64_t id = 1; id <= 100; id++) {
+        rec.id = WorkId(id);
+        store.put(rec);
+        REQUIRE(store.get(WorkId(1)) != nullptr); // kept hot by being read every time
+    }
+    REQUIRE(store.bytes() <= 8 * 1024);
+    REQUIRE(store.size() < 100);
+    REQUIRE(store.get(WorkId(100)) != nullptr);
+    REQUIRE(store.get(WorkId(2)) == nullptr);
+
+    // merging adds fields without dropping the old ones
+    WorkRecord title;
+    title.id = WorkId(100);
+    title.title = "title";
+    title.fields = WorkRecord::TITLE;
+    store.put(title);
+    auto merged = store.get(WorkId(100));
+    REQUIRE(merged->has(WorkRecord::TITLE | WorkRecord::REFS));
+    REQUIRE(merged->refs.size() == 100);
+}
+
+TEST_CASE("Batch Planning Test", "[batch]") {
+    std::vector<WorkId> ids;
+    for (int i = 0; i < 250; i++)
+        ids.push_back(WorkId(2000000000 + i));
+    auto batches = plan_batches(ids);
+    REQUIRE(batches.size() == 3);
+    REQUIRE(batches[0].size() == 100);
+    REQUIRE(batches[2].size() == 50);
+
+    // long external IDs are limited by URL length instead
+    const std::string doi = "https://doi.org/10.1000/" + std::string(200, 'x');
+    std::vector<WorkId> dois(100, WorkId::from_string(doi));
+    REQUIRE(dois[0].is_interned());
+    REQUIRE(dois[0].to_string() == doi);
+    for (const auto& batch : plan_batches(dois))
+        REQUIRE(batch.size() * doi.size() < 4000);
+
+    // plain W-numbers round trip through their integer form
+    REQUIRE(WorkId::from_string("https://openalex.org/W2079574144") == WorkId(2079574144));
+    REQUIRE(WorkId(2079574144).to_string() == "https://openalex.org/W2079574144");
+    REQUIRE(WorkId::parse("W2079574144") == WorkId(2079574144));
+    // anything else is not a W-number, however it ends
+    REQUIRE_FALSE(WorkId::parse("10.1234/w5678"));
+    REQUIRE_FALSE(WorkId::parse("https://doi.org/10.1234/W5678"));
+    REQUIRE_FALSE(WorkId::parse("https://openalex.org/works/W5678"));
+    REQUIRE(WorkId::from_string("10.1234/w5678").is_interned());
+}
+
+TEST_CASE("Request Scheduler Test", "[scheduler]") {
+    using namespace std::chrono_literals;
+    using std::chrono::steady_clock;
+
+    // a burst of 2, then 20 a second: the 4 requests past the burst wait at least 0.2 s for their tokens
+    RequestScheduler scheduler(20.0, 2.0, 3);
+    const auto begin = steady_clock::now();
+    scheduler.acquire(Lane::CRITICAL);
+    scheduler.acquire(Lane::CRITICAL);
+    REQUIRE(steady_clock::now() - begin < 50ms);
+    for (int i = 0; i < 4; i++) scheduler.acquire(Lane::PREFETCH);
+    REQUIRE(steady_clock::now() - begin >= 190ms);
+
+    // retries wait up to a doubling backoff, and at least as long as a Retry-After in seconds asks
+    std::mt19937 rng(1);
+    for (int attempt = 0; attempt < 10; attempt++) {
+        const auto delay = RequestScheduler::retry_delay(attempt, "", rng);
+        REQUIRE(delay >= 0ms);
+        REQUIRE(delay <= std::min<std::chrono::milliseconds>(30000ms, 500ms * (1 << attempt)));
+    }
+    REQUIRE(RequestScheduler::retry_delay(0, "3", rng) >= 3000ms);
+    REQUIRE(RequestScheduler::retry_delay(0, "Wed, 21 Oct 2015 07:28:00 GMT", rng) <= 500ms);
+}
+
+TEST_CASE("Work Decoder Test", "[decoder]") {
+    const std::string page = R"({
+        "meta": {"count": 2, "next_cursor": "IlsxMDAuMF0i", "groups_count": null},
+        "results": [
+            {"id": "https://openalex.org/W2079574144", "doi": "https://doi.org/10.1016/j.tibtech.2013.03.002",
+             "title": "Soft robotics: a bioinspired evolution in robotics", "publication_year": 2013,
+             "primary_location": {"source": {"id": "https://openalex.org/S1", "display_name": "x"}},
+             "concepts": [{"id": "https://openalex.org/C41008148", "level": 0, "score": 0.75},
+                          {"id": "https://openalex.org/C90509273", "score": 1}],
+             "referenced_works": ["https://openalex.org/W1", "https://openalex.org/W22"]},
+            {"id": "https://openalex.org/W3", "title": null, "publication_year": null, "referenced_works": []}
+        ]
+    })";
+    WorkBatch batch;
+    std::string cursor;
+    size_t count = 0;
+    REQUIRE(decode_works(page, batch, &cursor, &count));
+    REQUIRE(cursor == "IlsxMDAuMF0i");
+    REQUIRE(count == 2);
+    REQUIRE(batch.works.size() == 2);
+
+    const auto& w = batch.works[0];
+    REQUIRE(w.id == WorkId(2079574144));
+    REQUIRE(w.year == 2013);
+    REQUIRE(batch.title_of(w) == "Soft robotics: a bioinspired evolution in robotics");
+    REQUIRE(batch.refs_of(w).size() == 2);
+    REQUIRE(batch.refs_of(w)[1] == WorkId(22));
+    REQUIRE(batch.concepts_of(w).size() == 2);
+    REQUIRE(batch.concepts_of(w)[0].id == 41008148);
+    REQUIRE(batch.concepts_of(w)[1].score == 1.0f);
+
+    const auto& empty = batch.works[1];
+    REQUIRE(batch.record(empty).has(WorkRecord::YEAR | WorkRecord::REFS | WorkRecord::TITLE));
+    REQUIRE_FALSE(batch.record(empty).has(WorkRecord::CONCEPTS));
+    REQUIRE(batch.refs_of(empty).empty());
+
+    // a single work object decodes the same way
+    WorkBatch single;
+    REQUIRE(decode_works(R"({"referenced_works": ["https://openalex.org/W5"]})", single));
+    REQUIRE(single.works.size() == 1);
+    REQUIRE(single.refs_of(single.works[0])[0] == WorkId(5));
+
+    // a body cut short adds nothing, not even the works that were complete
+    const size_t refs = batch.refs.size(), titles = batch.titles.size();
+    REQUIRE_FALSE(decode_works(page.substr(0, page.find("W22")), batch, &cursor));
+    REQUIRE(batch.works.size() == 2);
+    REQUIRE(batch.refs.size() == refs);
+    REQUIRE(batch.titles.size() == titles);
+    REQUIRE(cursor.empty());
+}
+
+TEST_CASE("Offline Test", "[offline]") {
+    OfflineCache offline("knowledge_path_offline_test");
+    WorkCache& cache = offline.cache;
+    WorkRecord rec;
+    rec.id = WorkId(1);
+    rec.year = 2020;
+    rec.refs = {WorkId(2), WorkId(3)};
+    rec.fields = WorkRecord::YEAR | WorkRecord::REFS;
+    cache.put(rec);
+
+    // no client in the pool ever connects
+    ClientPool pool("api.openalex.org", 443, 2);
+    std::unordered_set<WorkId> not_fetched = {WorkId(1), WorkId(2)};
+    RefMap fetched_refs;
+    get_refs(pool, not_fetched, fetched_refs, 2000);
+    REQUIRE(not_fetched.empty());
+    REQUIRE(fetched_refs[WorkId(1)] == rec.refs);
+    REQUIRE(fetched_refs[WorkId(2)].empty());
+    REQUIRE(get_work(pool[0], "https://openalex.org/W1")["publication_year"] == 2020);
+    REQUIRE(get_work(pool[0], "https://openalex.org/W2").is_null());
+}
+
+TEST_CASE("Pipelined BFS Test", "[offline]") {
+    OfflineCache offline("knowledge_path_bfs_levels_test");
+    WorkCache& cache = offline.cache;
+    // 1000 references 1..50, each of which references 100 + i; only 150 references 999
+    WorkRecord rec;
+    rec.fields = WorkRecord::YEAR | WorkRecord::REFS;
+    rec.id = WorkId(1000); rec.year = 2020;
+    for (uint64_t i = 1; i <= 50; ++i) rec.refs.push_back(WorkId(i));
+    cache.put(rec);
+    for (uint64_t i = 1; i <= 50; ++i) {
+        rec.id = WorkId(i); rec.year = 2015; rec.refs = {WorkId(100 + i)};
+        cache.put(rec);
+        rec.id = WorkId(100 + i); rec.year = 2010; rec.refs = {};
+        if (i == 50) rec.refs = {WorkId(999)};
+        cache.put(rec);
+    }
+    rec.id = WorkId(999); rec.year = 2000; rec.refs = {};
+    cache.put(rec);
+
+    // the search that prefetches the next level finds the path the plain bfs finds
+    ClientPool pool("api.openalex.org", 443, 2);
+    Graph plain, pipelined;
+    plain.graph_by_bfs(pool, "W1000", "W999");
+    pipelined.graph_by_bfs_levels(pool, "W1000", "W999");
+    REQUIRE(plain.get_size() == 4);
+    REQUIRE(pipelined.get_size() == plain.get_size());
+    for (size_t i = 0; i < plain.get_size(); i++)
+        REQUIRE(pipelined.nodes()[i].work_id() == plain.nodes()[i].work_id());
+}
+
+TEST_CASE("Bidirectional Test", "[offline]") {
+    OfflineCache offline("knowledge_path_bidirectional_test");
+    WorkCache& cache = offline.cache;
+    // 30 → 20 → 10
+    WorkRecord rec;
+    rec.fields = WorkRecord::YEAR | WorkRecord::REFS;
+    rec.id = WorkId(30); rec.year = 2020; rec.refs = {WorkId(20)};
+    cache.put(rec);
+    rec.id = WorkId(20); rec.year = 2010; rec.refs = {WorkId(10)};
+    cache.put(rec);
+    rec.id = WorkId(10); rec.year = 2000; rec.refs = {};
+    cache.put(rec);
+
+    // citations need the API, so offline the search only gets there from the start's side, while its frontier
+    // is no larger than the target's
+    ClientPool pool("api.openalex.org", 443, 2);
+    RefMap citers;
+    REQUIRE(get_citers(pool, {WorkId(10)}, citers, 2020).empty());
+    REQUIRE(citers.empty());
+    Graph graph;
+    graph.graph_by_bidirectional(pool, "W30", "W10");
+    REQUIRE(graph.get_size() == 3);
+    REQUIRE(graph.nodes()[1].work_id() == WorkId(20));
+
+    // every cited work in the filter, and no citer newer than the start
+    const std::string request = cites_request({WorkId(10), WorkId(20)}, 2020);
+    REQUIRE(request.find("filter=cites:W10|W20,to_publication_date:2020-12-31") != std::string::npos);
+    REQUIRE(request.find("select=id,publication_year,referenced_works") != std::string::npos);
+}
+
+TEST_CASE("Local Graph Test", "[local]") {
+    const std::string path = fresh_path("knowledge_path_local_test");
+
+    // 30 → 20 → 10, 30 → 10, and a reference to a work outside the cache
+    WorkCache cache(path);
+    WorkRecord rec;
+    rec.fields = WorkRecord::YEAR | WorkRecord::REFS;
+    rec.id = WorkId(30); rec.year = 2020; rec.refs = {WorkId(20), WorkId(10), WorkId(99)};
+    cache.put(rec);
+    rec.id = WorkId(20); rec.year = 2010; rec.refs = {WorkId(10)};
+    cache.put(rec);
+    rec.id = WorkId(10); rec.year = 2000; rec.refs = {};
+    cache.put(rec);
+
+    // both edge encodings, built on one thread or several, give the same graph
+    for (size_t threads : {1, 4})
+    for (bool compress : {false, true}) {
+        REQUIRE(LocalGraph::build(path, cache, compress, threads));
+        LocalGraph graph(path);
+        REQUIRE(graph.is_open());
+        REQUIRE(graph.compressed() == compress);
+        REQUIRE(graph.node_count() == 3);
+        REQUIRE(graph.edge_count() == 3);
+        REQUIRE(graph.find(WorkId(99)) == LocalGraph::npos);
+
+        std::vector<uint32_t> buffer;
+        const uint32_t newest = graph.find(WorkId(30));
+        const uint32_t oldest = graph.find(WorkId(10));
+        REQUIRE(graph.id(newest) == WorkId(30));
+        REQUIRE(graph.year(newest) == 2020);
+        REQUIRE(graph.out_edges(newest, buffer).size() == 2);
+        REQUIRE(graph.out_edges(oldest, buffer).empty());
+        auto citers = graph.in_edges(oldest, buffer);
+        const uint32_t middle = graph.find(WorkId(20));
+        const auto [first, second] = std::minmax(middle, newest);
+        REQUIRE(std::vector<uint32_t>(citers.begin(), citers.end()) == std::vector<uint32_t>{first, second});
+        REQUIRE(graph.in_edges(newest, buffer).empty());
+        REQUIRE(graph.out_degree(newest) == 2);
+        REQUIRE(graph.in_degree(oldest) == 2);
+    }
+
+    // a truncated file is refused rather than mapped
+    const std::string file = LocalGraph::file_name(path, LocalGraph::latest_generation(path));
+    std::filesystem::resize_file(file, std::filesystem::file_size(file) - 4);
+    REQUIRE_FALSE(LocalGraph(path).is_open());
+}
+
+TEST_CASE("Local Graph Renumbering Test", "[local]") {
+    const std::string path = fresh_path("knowledge_path_renumber_test");
+
+    // a chain of works whose IDs are scattered across a wide range, each referencing the next one
+    const uint64_t n = 1000;
+    auto id_of = [](uint64_t i) { return WorkId(1 + i * 7919 % n * 1000003); };
+    WorkCache cache(path);
+    WorkRecord rec;
+    rec.fields = WorkRecord::YEAR | WorkRecord::REFS;
+    for (uint64_t i = 0; i < n; i++) {
+        rec.id = id_of(i); rec.year = static_cast<int>(3000 - i);
+        rec.refs = i + 1 < n ? std::vector<WorkId>{id_of(i + 1)} : std::vector<WorkId>{};
+        cache.put(rec);
+    }
+
+    // compressed, the chain is numbered in order (from wherever its smallest ID is, outwards), so every
+    // reference is to a node at most two numbers away
+    REQUIRE(LocalGraph::build(path, cache, true));
+    LocalGraph graph(path);
+    REQUIRE(graph.is_open());
+    std::vector<uint32_t> buffer;
+    for (uint64_t i = 0; i < n; i++) {
+        const uint32_t v = graph.find(id_of(i));
+        REQUIRE(graph.id(v) == id_of(i));
+        REQUIRE(graph.year(v) == static_cast<int>(3000 - i));
+        auto refs = graph.out_edges(v, buffer);
+        REQUIRE(refs.size() == (i + 1 < n ? 1 : 0));
+        if (!refs.empty()) {
+            REQUIRE(graph.id(refs[0]) == id_of(i + 1));
+            REQUIRE((refs[0] > v ? refs[0] - v : v - refs[0]) <= 2);
+        }
+    }
+    for (uint32_t i = 1; i < n; i++) REQUIRE(graph.id(graph.by_id(i - 1)) < graph.id(graph.by_id(i)));
+    REQUIRE(graph.find(WorkId(2)) == LocalGraph::npos);
+}
+
+TEST_CASE("Group Varint Test", "[local]") {
+    // gaps of every byte length, and list lengths that do and do not fill the last group
+    for (size_t n : {0, 1, 4, 5, 7, 300}) {
+        std::vector<uint32_t> list;
+        uint32_t v = 0;
+        for (size_t i = 0; i < n; i++) {
+            v += (i % 4 == 3) ? 1u << (8 * (i % 3)) : uint32_t(i * 977) % 70000;
+            list.push_back(v);
+        }
+        if (n == 300) list.back() = UINT32_MAX;
+
+        std::string bytes;
+        group_varint_encode(list, bytes);
+        const size_t length = bytes.size();
+        bytes.append(group_varint_padding, '\0');
+        std::vector<uint32_t> decoded = {42};
+        const uint8_t* begin = reinterpret_cast<const uint8_t*>(bytes.data());
+        REQUIRE(group_varint_decode(begin, decoded) == begin + length);
+        REQUIRE(decoded == list);
+    }
+}
+
+TEST_CASE("Graph Overlay Test", "[local]") {
+    const std::string path = fresh_path("knowledge_path_overlay_test");
+
+    // base graph 30 → 20 → 10, 30 → 10
+    {
+        WorkCache cache(path);
+        WorkRecord rec;
+        rec.fields = WorkRecord::YEAR | WorkRecord::REFS;
+        rec.id = WorkId(30); rec.year = 2020; rec.refs = {WorkId(20), WorkId(10)};
+        cache.put(rec);
+        rec.id = WorkId(20); rec.year = 2010; rec.refs = {WorkId(10)};
+        cache.put(rec);
+        rec.id = WorkId(10); rec.year = 2000; rec.refs = {};
+        cache.put(rec);
+        REQUIRE(LocalGraph::build(path, cache));
+    }
+
+    // update: 20 drops its reference, and a new work 40 cites 30 and 10
+    std::vector<WorkRecord> delta(2);
+    delta[0].id = WorkId(20); delta[0].year = 2010;
+    delta[1].id = WorkId(40); delta[1].year = 2022; delta[1].refs = {WorkId(30), WorkId(10)};
+    REQUIRE(append_delta(path, delta));
+
+    std::vector<uint32_t> buffer;
+    auto nodes_of = [&](std::span<const uint32_t> list, const GraphOverlay& g) {
+        std::vector<WorkId> ids;
+        for (uint32_t v : list) ids.push_back(g.id(v));
+        return ids;
+    };
+    {
+        LiveGraph live(path, 100);
+        auto g = live.snapshot();
+        REQUIRE(g->node_count() == 4);
+        REQUIRE(g->overlaid() == 2);
+        REQUIRE(g->year(g->find(WorkId(40))) == 2022);
+        REQUIRE(g->out_edges(g->find(WorkId(20)), buffer).empty());
+        REQUIRE(nodes_of(g->in_edges(g->find(WorkId(10)), buffer), *g) == std::vector<WorkId>{WorkId(30), WorkId(40)});
+        REQUIRE(nodes_of(g->in_edges(g->find(WorkId(30)), buffer), *g) == std::vector<WorkId>{WorkId(40)});
+        // the counts the bfs direction switch reads follow the delta too
+        REQUIRE(g->edge_count() == 4);
+        REQUIRE(g->in_degree(g->find(WorkId(10))) == 2);
+        REQUIRE(g->in_degree(g->find(WorkId(20))) == 1);
+    }
+
+    // past the threshold the delta is folded into a new graph file in the background; the old file goes with
+    // the last snapshot of it
+    LiveGraph live(path, 1);
+    live.wait();
+    auto g = live.snapshot();
+    REQUIRE(g->base().generation() == 2);
+    REQUIRE_FALSE(std::filesystem::exists(LocalGraph::file_name(path, 1)));
+    REQUIRE(g->overlaid() == 0);
+    REQUIRE(g->base().node_count() == 4);
+    REQUIRE(g->base().edge_count() == 4);
+    REQUIRE(nodes_of(g->in_edges(g->find(WorkId(10)), buffer), *g) == std::vector<WorkId>{WorkId(30), WorkId(40)});
+
+    // the next update starts the log over, and is picked up without waiting for another compaction
+    reset_delta(path, g->base().delta_mark());
+    delta.resize(1);
+    delta[0].id = WorkId(50); delta[0].year = 2023; delta[0].refs = {WorkId(40)};
+    REQUIRE(append_delta(path, delta));
+    LiveGraph updated(path, 100);
+    REQUIRE(updated.snapshot()->overlaid() == 1);
+    REQUIRE(updated.snapshot()->node_count() == 5);
+
+    // a full rebuild, as Ingest does it: a new graph from the cache alone, with older graphs and the log removed
+    {
+        WorkCache cache(path);
+        WorkRecord rec;
+        rec.fields = WorkRecord::YEAR | WorkRecord::REFS;
+        rec.id = WorkId(60); rec.year = 2024; rec.refs = {WorkId(30)};
+        cache.put(rec);
+        REQUIRE(LocalGraph::build(path, cache));
+    }
+    LocalGraph::remove_generations(path, 3);
+    std::filesystem::remove(path + ".kpd");
+    updated.refresh();
+    g = updated.snapshot();
+    REQUIRE(g->base().generation() == 3);
+    REQUIRE(g->overlaid() == 0);
+    REQUIRE(g->node_count() == 4);
+    REQUIRE(nodes_of(g->in_edges(g->find(WorkId(30)), buffer), *g) == std::vector<WorkId>{WorkId(60)});
+}
+
+TEST_CASE("Graph Test", "[graph]") {
+    // enough nodes that the node vector reallocates many times while edges are added
+    Graph graph;
+    const size_t n = 5000;
+    for (size_t i = 1; i < n; ++i) graph.add_edge(WorkId(i), WorkId(i + 1));
+    graph.add_edge(WorkId(1), WorkId(n / 2));
+    graph.finalize();
+
+    REQUIRE(graph.get_size() == n);
+    REQUIRE(graph.out_edges(0).size() == 2);
+    REQUIRE(graph.in_edges(n / 2 - 1).size() == 2);
+    REQUIRE(graph.bfs(n - 1).size() == n);
+
+    // edges are followed either way, and the shortcut 1 → n/2 is taken
+    const std::vector<size_t> path = graph.shortest_path(n - 1, 0);
+    REQUIRE(path.size() == n / 2 + 2);
+    REQUIRE(path.back() == 0);
+    REQUIRE(path[path.size() - 2] == n / 2 - 1);
+}
+
+TEST_CASE("Graph Builder Test", "[graph]") {
+    // workers add overlapping chains 1 → 2 → ... → 1000; every node and edge should come out exactly once per add
+    GraphBuilder builder;
+    const size_t workers = 8, n = 1000;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < workers; ++t) {
+        threads.emplace_back([&, t] {
+            GraphBuilder::Writer writer = builder.writer();
+            for (size_t i = 1 + t; i < n; i += workers) writer.add_edge(WorkId(i), WorkId(i + 1));
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    Graph graph = builder.finalize();
+
+    REQUIRE(graph.get_size() == n);
+    REQUIRE(graph.directed_edges().size() == n - 1);
+    size_t first = 0, last = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (graph.nodes()[i].work_id() == WorkId(1)) first = i;
+        if (graph.nodes()[i].work_id() == WorkId(n)) last = i;
+    }
+    REQUIRE(graph.shortest_path(first, last).size() == n);
+    REQUIRE(graph.out_edges(last).empty());
+    REQUIRE(graph.in_edges(first).empty());
+}
+
+TEST_CASE("Flat Map Test", "[graph]") {
+    const uint64_t n = 100000;
+    FlatMap<WorkId, uint64_t> map;
+    for (uint64_t i = 1; i <= n; ++i) map[WorkId(i * 7)] = i;
+    REQUIRE(map.size() == n);
+    REQUIRE(!map.try_emplace(WorkId(7), 0).second);
+
+    bool all_found = true;
+    for (uint64_t i = 1; i <= n; ++i) {
+        auto it = map.find(WorkId(i * 7));
+        all_found = all_found && it != map.end() && it->second == i && !map.contains(WorkId(i * 7 + 1));
+    }
+    REQUIRE(all_found);
+    uint64_t sum = 0;
+    for (const auto& [id, i] : map) sum += i;
+    REQUIRE(sum == n * (n + 1) / 2);
+    REQUIRE_THROWS_AS(map.at(WorkId(1)), std::out_of_range);
+
+    // a reserved map holds that many entries without growing
+    FlatMap<uint32_t, uint32_t> reserved(n);
+    const size_t capacity = reserved.capacity();
+    for (uint32_t i = 0; i < n; ++i) reserved[i] = i;
+    REQUIRE(reserved.capacity() == capacity);
+    reserved.clear();
+    REQUIRE(reserved.empty());
+    REQUIRE(!reserved.contains(5));
+    // cleared by the keys of a few entries, which may collide, and filled again
+    std::vector<uint32_t> keys;
+    for (uint32_t i = 0; i < 1000; ++i) keys.push_back(i * 4096);
+    for (const uint32_t key : keys) reserved[key] = key;
+    reserved.clear(keys);
+    REQUIRE(reserved.empty());
+    bool all_gone = true;
+    for (const uint32_t key : keys) all_gone = all_gone && !reserved.contains(key);
+    REQUIRE(all_gone);
+    reserved[4096] = 1;
+    REQUIRE(reserved.size() == 1);
+    REQUIRE(reserved.at(4096) == 1);
+
+    FlatSet<WorkId> set;
+    REQUIRE(set.insert(WorkId(3)));
+    REQUIRE(!set.insert(WorkId(3)));
+    REQUIRE(set.count(WorkId(3)) == 1);
+}
+
+TEST_CASE("A* Test", "[offline]") {
+    OfflineCache offline("knowledge_path_astar_test");
+
+    // 1 → 2 → 3 → 5 and the shorter 1 → 4 → 5; 6 is older than the target and is never expanded
+    WorkCache& cache = offline.cache;
+    WorkRecord rec;
+    rec.fields = WorkRecord::YEAR | WorkRecord::REFS;
+    rec.id = WorkId(1); rec.year = 2020; rec.refs = {WorkId(2), WorkId(4), WorkId(6)};
+    cache.put(rec);
+    rec.id = WorkId(2); rec.year = 2019; rec.refs = {WorkId(3)};
+    cache.put(rec);
+    rec.id = WorkId(3); rec.year = 2018; rec.refs = {WorkId(5)};
+    cache.put(rec);
+    rec.id = WorkId(4); rec.year = 2001; rec.refs = {WorkId(5)};
+    cache.put(rec);
+    rec.id = WorkId(5); rec.year = 2000; rec.refs = {};
+    cache.put(rec);
+    rec.id = WorkId(6); rec.year = 1990; rec.refs = {WorkId(5)};
+    cache.put(rec);
+
+    ClientPool pool("api.openalex.org", 443, 1);
+    Graph graph;
+    graph.graph_by_astar(pool, "W1", "W5");
+    REQUIRE(graph.get_size() == 3);
+    REQUIRE(graph.nodes()[1].work_id() == WorkId(4));
+}
+
+TEST_CASE("Local BFS Test", "[offline]") {
+    OfflineCache offline("knowledge_path_local_bfs_test");
+    const std::string& path = offline.path;
+
+    // 10000 references 1..5000, which all reference the hub 7000, the only work citing 9999
+    // the wide second level is expanded bottom-up; with several threads, in more than one chunk
+    WorkCache& cache = offline.cache;
+    WorkRecord rec;
+    rec.fields = WorkRecord::YEAR | WorkRecord::REFS;
+    rec.id = WorkId(10000); rec.year = 2020;
+    for (uint64_t i = 1; i <= 5000; ++i) rec.refs.push_back(WorkId(i));
+    cache.put(rec);
+    for (uint64_t i = 1; i <= 5000; ++i) {
+        rec.id = WorkId(i); rec.year = 2010; rec.refs = {WorkId(7000)};
+        cache.put(rec);
+    }
+    rec.id = WorkId(7000); rec.year = 2005; rec.refs = {WorkId(9999)};
+    cache.put(rec);
+    rec.id = WorkId(9999); rec.year = 2000; rec.refs = {};
+    cache.put(rec);
+
+    ClientPool pool("api.openalex.org", 443, 1);
+    for (bool compress : {false, true})
+    for (size_t threads : {1, 4}) {
+        REQUIRE(LocalGraph::build(path, cache, compress));
+        LiveGraph live(path, 100);
+        Graph graph;
+        graph.graph_by_local_bfs(*live.snapshot(), pool[0], "W10000", "W9999", threads);
+        REQUIRE(graph.get_size() == 4);
+        REQUIRE(graph.nodes()[2].work_id() == WorkId(7000));
+        // the next search starts from what the last one left of the shared state
+        Graph again;
+        again.graph_by_local_bfs(*live.snapshot(), pool[0], "W5000", "W9999", threads);
+        REQUIRE(again.get_size() == 3);
+    }
+}
+
+TEST_CASE("K Paths Test", "[offline]") {
+    OfflineCache offline("knowledge_path_k_paths_test");
+    const std::string& path = offline.path;
+
+    // 1 → 2 → 5, 1 → 3 → 5 and 1 → 4 → 6 → 5
+    WorkCache& cache = offline.cache;
+    WorkRecord rec;
+    rec.fields = WorkRecord::YEAR | WorkRecord::REFS;
+    rec.id = WorkId(1); rec.year = 2020; rec.refs = {WorkId(2), WorkId(3), WorkId(4)};
+    cache.put(rec);
+    for (uint64_t i : {2, 3, 6}) {
+        rec.id = WorkId(i); rec.year = 2010; rec.refs = {WorkId(5)};
+        cache.put(rec);
+    }
+    rec.id = WorkId(4); rec.year = 2015; rec.refs = {WorkId(6)};
+    cache.put(rec);
+    rec.id = WorkId(5); rec.year = 2000; rec.refs = {};
+    cache.put(rec);
+    REQUIRE(LocalGraph::build(path, cache));
+
+    ClientPool pool("api.openalex.org", 443, 1);
+    LiveGraph live(path, 100);
+    for (bool local : {false, true}) {
+        Graph graph;
+        if (local) graph.graph_by_local_k_paths(*live.snapshot(), pool[0], "W1", "W5", 5);
+        else graph.graph_by_k_paths(pool, "W1", "W5", 5);
+        REQUIRE(graph.paths().size() == 3);
+        REQUIRE(graph.paths()[0].size() == 3);
+        REQUIRE(graph.paths()[1].size() == 3);
+        REQUIRE(graph.paths()[2].size() == 4);
+        REQUIRE(graph.get_size() == 6);
+        REQUIRE(graph.directed_edges().size() == 7);
+    }
+}
+
+TEST_CASE("Path DAG Test", "[offline]") {
+    OfflineCache offline("knowledge_path_dag_test");
+    const std::string& path = offline.path;
+
+    // 1 references 2 and 3, each pair references both of the next pair, ..., and the last pair references 1000:
+    // 2^70 shortest paths; 1 → 999 → 998 → 4 only adds longer ones
+    const uint64_t layers = 70;
+    WorkCache& cache = offline.cache;
+    WorkRecord rec;
+    rec.fields = WorkRecord::YEAR | WorkRecord::REFS;
+    rec.id = WorkId(1); rec.year = 2100; rec.refs = {WorkId(2), WorkId(3), WorkId(999)};
+    cache.put(rec);
+    for (uint64_t l = 0; l < layers; ++l) {
+        for (uint64_t i : {2 * l + 2, 2 * l + 3}) {
+            rec.id = WorkId(i); rec.year = static_cast<int>(2099 - l);
+            rec.refs = l + 1 < layers ? std::vector<WorkId>{WorkId(2 * l + 4), WorkId(2 * l + 5)} : std::vector<WorkId>{WorkId(1000)};
+            cache.put(rec);
+        }
+    }
+    rec.id = WorkId(999); rec.year = 2099; rec.refs = {WorkId(998)};
+    cache.put(rec);
+    rec.id = WorkId(998); rec.year = 2098; rec.refs = {WorkId(4)};
+    cache.put(rec);
+    rec.id = WorkId(1000); rec.year = 1900; rec.refs = {};
+    cache.put(rec);
+    REQUIRE(LocalGraph::build(path, cache));
+
+    ClientPool pool("api.openalex.org", 443, 1);
+    LiveGraph live(path, 100);
+    for (bool local : {false, true}) {
+        Graph graph;
+        if (local) graph.graph_by_local_path_dag(*live.snapshot(), pool[0], "W1", "W14", 3);
+        else graph.graph_by_path_dag(pool, "W1", "W14", 3);
+        REQUIRE(graph.path_count() == PathCount(64));
+        REQUIRE(graph.paths().size() == 3);
+    }
+    Graph deep;
+    deep.graph_by_local_path_dag(*live.snapshot(), pool[0], "W1", "W1000", 1);
+    REQUIRE(deep.path_count().to_string() == "1180591620717411303424");
+
+    // the paths are listed one at a time, all different and all shortest
+    RefMap refs;
+    cache.for_each([&](size_t, const WorkRecord& work) { refs[work.id] = work.refs; });
+    auto lookup = [&](WorkId id) -> const std::vector<WorkId>& { return refs[id]; };
+    PathDag dag = PathDag::build(WorkId(1), WorkId(14), SIZE_MAX, SIZE_MAX, [](const std::vector<WorkId>&) {}, lookup);
+    REQUIRE(dag.hops() == 7);
+    REQUIRE(dag.count() == PathCount(64));
+    std::set<std::vector<WorkId>> listed;
+    std::vector<WorkId> id_path;
+    for (auto paths = dag.paths(); paths.next(id_path); ) {
+        REQUIRE(id_path.size() == 8);
+        listed.insert(id_path);
+    }
+    REQUIRE(listed.size() == 64);
+
+    // expanding 1, its three references and one work of the next level does not get near 14
+    REQUIRE(PathDag::build(WorkId(1), WorkId(14), SIZE_MAX, 5, [](const std::vector<WorkId>&) {}, lookup).empty());
+}
+
+
+TEST_CASE("Batch Search Test", "[offline]") {
+    OfflineCache offline("knowledge_path_batch_test");
+
+    // 1 → 2 → 4 → 6 and 1 → 3 → 5 → 6; 8 → 2; 7 is referenced by nothing
+    WorkCache& cache = offline.cache;
+    WorkRecord rec;
+    rec.fields = WorkRecord::YEAR | WorkRecord::REFS;
+    const std::vector<std::pair<int, std::vector<WorkId>>> works = {
+        {2020, {WorkId(2), WorkId(3)}}, {2019, {WorkId(4)}}, {2019, {WorkId(5)}}, {2018, {WorkId(6)}},
+        {2018, {WorkId(6)}}, {2010, {}}, {2015, {}}, {2021, {WorkId(2)}}};
+    for (size_t i = 0; i < works.size(); ++i) {
+        rec.id = WorkId(i + 1); rec.year = works[i].first; rec.refs = works[i].second;
+        cache.put(rec);
+    }
+
+    ClientPool pool("api.openalex.org", 443, 1);
+    const std::vector<PairQuery> pairs = {{"W1", "W6"}, {"W1", "W4"}, {"W1", "W7"}, {"W6", "W1"},
+                                          {"W1", "W99"}, {"W8", "W6"}, {"W1", "W1"}, {"W1", "W4"}};
+    std::vector<PairResult> results(pairs.size());
+    std::vector<int> emitted(pairs.size());
+    BatchSearch search(pool, 2);
+    search.run(pairs, [&](const PairResult& result) {
+        results[result.index] = result;
+        emitted[result.index]++;
+    });
+    // every pair gets exactly one result
+    REQUIRE(emitted == std::vector<int>(pairs.size(), 1));
+    REQUIRE(results[0].path.size() == 4);
+    REQUIRE(results[0].path.front() == WorkId(1));
+    REQUIRE(results[0].path.back() == WorkId(6));
+    REQUIRE(results[1].path == std::vector<WorkId>{WorkId(1), WorkId(2), WorkId(4)});
+    REQUIRE(results[7].path == results[1].path);
+    REQUIRE(results[2].path.empty());
+    REQUIRE(results[2].error.empty());
+    REQUIRE_FALSE(results[3].error.empty());
+    REQUIRE_FALSE(results[4].error.empty());
+    REQUIRE(results[5].path == std::vector<WorkId>{WorkId(8), WorkId(2), WorkId(4), WorkId(6)});
+    REQUIRE(results[6].path == std::vector<WorkId>{WorkId(1)});
+    // the two searches share their works: each of the nine is fetched once
+    REQUIRE(search.fetched() == 9);
+
+    // one start at a time, what the first search fetched is dropped before the second runs, with the same results
+    BatchSearch one_by_one(pool, 1);
+    one_by_one.run(pairs, [&](const PairResult& result) {
+        REQUIRE(result.path == results[result.index].path);
+        REQUIRE(result.error == results[result.index].error);
+    });
+    REQUIRE(one_by_one.fetched() > 9);
+}